@@ -25,6 +25,7 @@ extern "C"
 #endif
 
 #define LEDA_TAG_NAME                           "LINKEDGE_DEVICE_ACCESS"
+#define LEDA_MAX_CONNECTION_NUMS                16                  /* DBus连接数上限 */
 
 typedef int device_handle_t;                                        /* linkedge本地连接设备唯一标识符类型 */
 #define INVALID_DEVICE_HANDLE                   -1                  /* 不合法的device_handle */
@@ -207,14 +208,81 @@ device_handle_t leda_register_and_online_by_local_name(const char *product_key,
  *
  * worker_thread_nums : 线程池工作线程数, 该数值根据注册设备数量进行设置.
  *
+ * 同一设备的请求按到达顺序串行执行, 不同设备的请求在工作线程间并行执行, 设备回调内无需为并发加锁.
+ * 不同设备的请求按类型区分优先级: 配置变更通知 > 属性获取 > 属性设置 > 服务调用.
+ *
  * 阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
  */
 int leda_init(int worker_thread_nums);
 
+/*
+ * 线程池调度模式
+ */
+typedef enum leda_pool_mode
+{
+    LEDA_POOL_MODE_SHARED = 0,                                      /* 共享模式, 所有工作线程竞争同一任务队列, 默认模式 */
+    LEDA_POOL_MODE_STEALING,                                        /* 窃取模式, 每个工作线程一个任务队列, 空闲线程从其他队列窃取任务, 适用于多核高并发短请求场景 */
+
+    LEDA_POOL_MODE_BUTT
+} leda_pool_mode_e;
+
+/*
+ * 请求队列水位变化回调, 需驱动开发者实现, 可用于在请求积压时降低设备轮询等负载.
+ *
+ * is_high:     1表示排队请求数达到高水位, 0表示排队请求数回落到高水位的一半以下.
+ * queue_size:  当前排队请求数.
+ *
+ * 注: 回调在SDK内部线程中执行, 需尽快返回, 不能调用阻塞接口.
+ */
+typedef void (*queue_watermark_callback)(int is_high, int queue_size);
+
+/*
+ * SDK内部线程调度配置, 值为0的字段表示保持系统默认.
+ */
+typedef struct leda_thread_sched
+{
+    unsigned long       cpu_mask;                                   /* CPU亲和性位掩码, 第n位表示允许运行在CPU n上, 0表示不绑定 */
+    int                 sched_policy;                               /* 调度策略, SCHED_OTHER(0), SCHED_FIFO或SCHED_RR, 实时策略需要root或CAP_SYS_NICE权限 */
+    int                 sched_priority;                             /* 实时调度优先级, 仅SCHED_FIFO/SCHED_RR有效 */
+    int                 nice;                                       /* nice值, 范围[-20, 19], 仅SCHED_OTHER有效 */
+} leda_thread_sched_t;
+
+/*
+ * 驱动模块初始化配置, 使用前需memset清零, 值为0的字段使用默认配置.
+ */
+typedef struct leda_init_config
+{
+    int                 worker_thread_nums;                         /* 线程池工作线程数, 该数值根据注册设备数量进行设置, 必须大于0 */
+    leda_pool_mode_e    pool_mode;                                  /* 线程池调度模式, 参考@leda_pool_mode_e */
+    int                 request_timeout_ms;                         /* 设备请求排队超时时间(毫秒), 排队超时未执行的请求直接回复LE_ERROR_TIMEOUT, 不再调用设备回调, 0表示不超时 */
+    int                 max_queue_size;                             /* 排队设备请求数上限, 队列满时新请求直接回复LE_ERROR_SERVICE_UNREACHABLE, 0表示不限制 */
+    int                 queue_high_watermark;                       /* 排队设备请求数高水位, 0表示取max_queue_size的3/4 */
+    queue_watermark_callback queue_watermark_cb;                    /* 请求队列水位变化回调, 可为NULL */
+    int                 min_thread_nums;                            /* 弹性线程池最少工作线程数, 大于0时线程数在[min_thread_nums, worker_thread_nums]之间按负载伸缩, 仅共享模式有效; 0表示线程数固定 */
+    int                 thread_spawn_wait_ms;                       /* 弹性线程池中请求排队等待超过该时间且无空闲线程时新增工作线程, 0表示默认10毫秒 */
+    int                 thread_idle_timeout_ms;                     /* 弹性线程池中工作线程空闲超过该时间后退出, 0表示默认60000毫秒 */
+    int                 thread_stack_size;                          /* 工作线程栈大小(字节), 不能小于PTHREAD_STACK_MIN, 0表示使用系统默认值 */
+    leda_thread_sched_t dispatcher_sched;                           /* 消息分发线程(leda_dbus_loop_thread及分片连接的leda_dbus_N)调度配置 */
+    leda_thread_sched_t worker_sched;                               /* 线程池工作线程(leda_worker_N)调度配置 */
+    int                 shutdown_timeout_ms;                        /* 模块退出时等待已接收请求执行完毕的最长时间(毫秒), 超时仍未执行的请求直接回复LE_ERROR_SERVICE_UNREACHABLE, 0表示默认3000毫秒 */
+    int                 connection_nums;                            /* DBus连接数, 大于1时设备按cloud_id哈希分布到各连接, 每个连接一个消息分发线程, 最大LEDA_MAX_CONNECTION_NUMS, 0表示1 */
+    int                 tsl_cache_max_bytes;                        /* 物模型缓存内存上限(字节), 超过时淘汰最久未使用的产品物模型, 下次使用时重新获取, 0表示不限制 */
+} leda_init_config_t;
+
+/*
+ * 驱动模块初始化, 功能同leda_init, 通过config指定线程池等扩展配置.
+ *
+ * config: 初始化配置, 详细描述见@leda_init_config.
+ *
+ * 阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_init_ex(const leda_init_config_t *config);
+
 /*
  * 驱动模块退出.
  *
  * 模块退出前, 释放资源.
+ * 退出时不再接收新请求, 已接收的请求继续执行; 超过shutdown_timeout_ms仍未执行的请求直接回复LE_ERROR_SERVICE_UNREACHABLE.
  *
  * 阻塞接口.
  */
@@ -410,6 +478,229 @@ int leda_get_tsl_ext_info(const char *product_key, char *tsl_ext_info, int size)
  */
 device_handle_t leda_get_device_handle(const char *product_key, const char *device_name);
 
+/*
+ * 请求类型, 用于区分线程池统计
+ */
+typedef enum leda_op_type
+{
+    LEDA_OP_CONFIG = 0,                                             /* 配置变更通知 */
+    LEDA_OP_GET,                                                    /* 属性获取 */
+    LEDA_OP_SET,                                                    /* 属性设置 */
+    LEDA_OP_SERVICE,                                                /* 服务调用 */
+
+    LEDA_OP_BUTT
+} leda_op_type_e;
+
+#define LEDA_LATENCY_BUCKET_NUM                 32                  /* 耗时直方图桶数目 */
+
+/*
+ * 耗时直方图, 按2的幂次分桶, 单位微秒.
+ * buckets[0]统计小于1微秒的请求数, buckets[i]统计耗时在[2^(i-1), 2^i)微秒的请求数, 超出范围的计入最后一个桶.
+ */
+typedef struct leda_latency_histogram
+{
+    unsigned long       count;                                      /* 请求数 */
+    unsigned long long  sum_us;                                     /* 总耗时 */
+    unsigned long long  max_us;                                     /* 最大耗时 */
+    unsigned long       buckets[LEDA_LATENCY_BUCKET_NUM];
+} leda_latency_histogram_t;
+
+/*
+ * 线程池统计信息, 各计数从leda_init开始累计.
+ */
+typedef struct leda_pool_stats
+{
+    leda_latency_histogram_t    queue_wait[LEDA_OP_BUTT];           /* 请求从提交到开始执行的等待时间, 包括在同一设备串行通道内的等待 */
+    leda_latency_histogram_t    run_time[LEDA_OP_BUTT];             /* 设备回调执行时间 */
+    unsigned long               discards[LEDA_OP_BUTT];             /* 排队超时未执行的请求数 */
+    unsigned long               rejects;                            /* 队列满被拒绝的请求数 */
+    int                         queue_size;                         /* 当前排队请求数 */
+    int                         thread_nums;                        /* 当前工作线程数 */
+    unsigned long               slot_hits;                          /* 任务从预分配任务槽分配的次数 */
+    unsigned long               slot_fallbacks;                     /* 任务槽用完后动态分配的次数 */
+    unsigned long               request_hits;                       /* 请求从预分配内存块分配的次数 */
+    unsigned long               request_fallbacks;                  /* 请求动态分配的次数 */
+    unsigned long               reply_orphans;                      /* 同步调用应答到达时没有调用者在等待的次数 */
+    unsigned long               reply_expired;                      /* 无人认领超时释放的应答数, 多为调用超时后才到达的迟到应答 */
+    unsigned long               reply_drops;                        /* 无人认领的应答数超过上限而被丢弃的数目 */
+} leda_pool_stats_t;
+
+/*
+ * 获取线程池统计信息, 用于区分请求耗时是在线程池排队还是在设备回调中.
+ *
+ * stats: 统计信息, 详细描述见@leda_pool_stats.
+ *
+ * 非阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_get_pool_stats(leda_pool_stats_t *stats);
+
+#define LEDA_DEVICE_FLAG_NONBLOCKING_GET        0x1                 /* 属性获取回调不会阻塞, 如只读取内存中的缓存值 */
+
+/*
+ * 设置设备标志.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识.
+ * flags:       设备标志, LEDA_DEVICE_FLAG_*按位或, 0表示清除所有标志.
+ *
+ * 注: 设置LEDA_DEVICE_FLAG_NONBLOCKING_GET后, 设备没有排队或执行中的请求时, 属性获取回调直接在消息分发线程中执行并应答, 省去线程池的两次线程切换;
+ *     此时回调内不能阻塞, 也不能调用SDK的阻塞接口, 否则会阻塞所有设备的消息分发.
+ *
+ * 非阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_set_device_flags(device_handle_t dev_handle, int flags);
+
+/*
+ * 设备类异步接口完成回调.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识, 设备注册失败时为INVALID_DEVICE_HANDLE.
+ * ret:         成功返回LE_SUCCESS, 等待应答超时返回LE_ERROR_TIMEOUT, 其他失败返回错误码.
+ * cb_data:     调用异步接口时传入的私有数据.
+ */
+typedef void (*leda_device_result_callback)(device_handle_t dev_handle, int ret, void *cb_data);
+
+/*
+ * 配置类异步接口完成回调.
+ *
+ * ret:         成功返回LE_SUCCESS, 等待应答超时返回LE_ERROR_TIMEOUT, 其他失败返回错误码.
+ * value:       获取到的内容, 失败时为NULL, 回调返回后失效.
+ * cb_data:     调用异步接口时传入的私有数据.
+ */
+typedef void (*leda_config_result_callback)(int ret, const char *value, void *cb_data);
+
+/*
+ * 异步接口回调执行器, 由用户实现, 将task投递到用户自己的线程或事件循环中, 并在其中调用task(arg).
+ *
+ * task:            待执行的回调任务, 必须且只能执行一次.
+ * arg:             回调任务参数.
+ * executor_data:   设置执行器时传入的私有数据.
+ */
+typedef void (*leda_executor_callback)(void (*task)(void *arg), void *arg, void *executor_data);
+
+/*
+ * 设置异步接口回调执行器, 可随时设置, 之后完成的回调使用新的执行器.
+ *
+ * executor:        回调执行器, NULL表示在SDK线程中直接回调.
+ * executor_data:   执行器私有数据.
+ *
+ * 注: 未设置执行器时, 完成回调在SDK的线程池线程中执行, 回调内不宜长时间阻塞.
+ *
+ * 非阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_set_async_executor(leda_executor_callback executor, void *executor_data);
+
+/*
+ * 通过已在阿里云物联网平台创建的设备device_name, 注册并上线设备, 异步接口, 参数同@leda_register_and_online_by_device_name.
+ *
+ * result_cb:   完成回调, 成功时dev_handle为设备在linkedge本地唯一标识.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_register_and_online_by_device_name_async(const char *product_key, 
+                                                  const char *device_name, 
+                                                  leda_device_callback_t *device_cb, 
+                                                  void *usr_data, 
+                                                  leda_device_result_callback result_cb, 
+                                                  void *cb_data);
+
+/*
+ * 通过本地自定义设备名称, 注册并上线设备, 异步接口, 参数同@leda_register_and_online_by_local_name.
+ *
+ * result_cb:   完成回调, 成功时dev_handle为设备在linkedge本地唯一标识.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_register_and_online_by_local_name_async(const char *product_key, 
+                                                 const char *local_name, 
+                                                 leda_device_callback_t *device_cb, 
+                                                 void *usr_data, 
+                                                 leda_device_result_callback result_cb, 
+                                                 void *cb_data);
+
+/*
+ * 上线设备, 异步接口.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识.
+ * result_cb:   完成回调.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_online_async(device_handle_t dev_handle, leda_device_result_callback result_cb, void *cb_data);
+
+/*
+ * 下线设备, 异步接口.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识.
+ * result_cb:   完成回调.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_offline_async(device_handle_t dev_handle, leda_device_result_callback result_cb, void *cb_data);
+
+/*
+ * 注销设备, 异步接口, 设备在线时先下线.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识.
+ * result_cb:   完成回调.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_unregister_async(device_handle_t dev_handle, leda_device_result_callback result_cb, void *cb_data);
+
+/*
+ * 获取驱动配置, 异步接口, 配置内容格式见@leda_get_config.
+ *
+ * result_cb:   完成回调, 成功时value为驱动配置.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_get_config_async(leda_config_result_callback result_cb, void *cb_data);
+
+/*
+ * 获取指定产品ProductKey对应物模型内容, 异步接口.
+ *
+ * product_key: 产品ProductKey.
+ * result_cb:   完成回调, 成功时value为物模型内容.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_get_tsl_async(const char *product_key, leda_config_result_callback result_cb, void *cb_data);
+
+#define LEDA_REGISTER_WINDOW_DEFAULT            32                  /* 批量注册默认同时等待应答的最大请求数 */
+
+/*
+ * 批量注册设备信息.
+ */
+typedef struct leda_device_register_info
+{
+    const char                  *product_key;               /* 产品ProductKey */
+    const char                  *device_name;               /* 设备DeviceName, is_local_name非0时为本地自定义设备名称 */
+    int                         is_local_name;              /* device_name是否为本地自定义设备名称 */
+    leda_device_callback_t      *device_cb;                 /* 设备回调函数结构体，详细描述见@leda_device_callback */
+    void                        *usr_data;                  /* 设备私有数据, 在回调中会传给设备 */
+} leda_device_register_info_t;
+
+/*
+ * 批量注册并上线设备.
+ *
+ * devices:     待注册设备数组, 详细描述见@leda_device_register_info.
+ * count:       设备个数.
+ * handles:     输出各设备在linkedge本地唯一标识, 注册失败的设备为INVALID_DEVICE_HANDLE, 数组长度不小于count.
+ * window:      同时等待应答的最大请求数, 小于等于0时使用LEDA_REGISTER_WINDOW_DEFAULT.
+ *
+ * 注: 请求在窗口内连续发出, 不必逐个等待应答, 适合驱动启动时上线大量设备.
+ * 注: 在设备回调等线程池工作线程中调用时逐个同步注册, 避免等待线程池执行异步完成而死锁.
+ *
+ * 阻塞接口, 返回注册成功的设备个数, 参数错误返回错误码.
+ */
+int leda_register_and_online_batch(const leda_device_register_info_t devices[], int count, device_handle_t handles[], int window);
+
 #ifdef __cplusplus  /* If this is a C++ compiler, use C linkage */
 }
 #endif
@@ -27,13 +27,17 @@
 #include <cJSON.h>
 #include <dbus/dbus.h>
 #include <sys/time.h>
+#include <limits.h>
+#include <sched.h>
 
 #include "log.h"
 #include "le_error.h"
 #include "leda.h"
 #include "linux-list.h"
 #include "leda_base.h"
+#include "leda_mainloop.h"
 #include "leda_methodcb.h"
+#include "leda_trpool.h"
 
 #ifdef __cplusplus /* If this is a C++ compiler, use C linkage */
 extern "C"
@@ -51,14 +55,17 @@ typedef enum leda_info_type
 
 static char                                 *g_module_id   = NULL;
 static char                                 *g_module_name = NULL;
-static DBusConnection                       *g_connection  = NULL;  /* dbus连接句柄 */
-static pthread_t                            g_methodcb_thread_id;   /* 线程句柄 */
+static DBusConnection                       *g_connection  = NULL;  /* dbus主连接句柄 */
+static leda_connect_info_t                  *g_connect_info[LEDA_MAX_CONNECTION_NUMS];  /* 各连接及其消息分发线程 */
+static int                                  g_connection_nums = 0;  /* 连接数 */
 static device_handle_t                      g_device_handle  = 0;   /* device handle分配索引 */
 
 extern pthread_mutex_t                      g_methodcb_list_lock;
 extern pthread_mutex_t                      g_leda_reply_lock;
 extern pthread_mutex_t                      g_device_configcb_lock;
 
+static int _leda_tsl_subscribe(const char *product_key);
+
 static device_handle_t _get_unique_device_handle(void)
 {
     return g_device_handle++;
@@ -166,7 +173,13 @@ static int _leda_check_wkn(const char *head, const char *params)
     return LE_SUCCESS;
 }
 
-static int _leda_request_wkn(const char *head, const char *params)
+/* 设备WKN所在的连接, 按cloud_id哈希分片 */
+static DBusConnection *_leda_device_connection(const leda_device_info_t *device_info)
+{
+    return g_connect_info[device_info->cloud_id_hash % g_connection_nums]->connection;
+}
+
+static int _leda_request_wkn(DBusConnection *connection, const char *head, const char *params)
 {
     DBusMessage *message    = NULL;
     char        *wkn        = NULL;
@@ -196,14 +209,14 @@ static int _leda_request_wkn(const char *head, const char *params)
         return LE_ERROR_UNKNOWN;
     }
 
-    dbus_connection_send(g_connection, message, NULL);
+    dbus_connection_send(connection, message, NULL);
     dbus_message_unref(message);
     free(wkn);
 
     return LE_SUCCESS;
 }
 
-static int _leda_release_wkn(const char *head, const char *params)
+static int _leda_release_wkn(DBusConnection *connection, const char *head, const char *params)
 {
     DBusMessage *message    = NULL;
     char        *wkn        = NULL;
@@ -232,18 +245,17 @@ static int _leda_release_wkn(const char *head, const char *params)
         return LE_ERROR_UNKNOWN;
     }
   
-    dbus_connection_send(g_connection, message, NULL);
+    dbus_connection_send(connection, message, NULL);
     dbus_message_unref(message);
     free(wkn);
 
     return LE_SUCCESS;
 }
 
-static int _leda_send_signal(const char *signal_name, const char *cloud_id, char *output)
+/* 以设备的名义发送信号, 接口名和对象路径使用注册时生成的字符串 */
+/* output由leda_json_write_data生成, 结构必然合法, 只需校验UTF-8 */
+static int _leda_send_signal(const char *signal_name, const leda_device_info_t *device_info, char *output)
 {
-    cJSON           *object         = NULL;
-    char            *path           = NULL;
-    char            *interface      = NULL;
     DBusMessage     *signal_msg     = NULL;
 
     if (LE_SUCCESS != leda_string_validate_utf8(output, strlen(output)))
@@ -251,40 +263,11 @@ static int _leda_send_signal(const char *signal_name, const char *cloud_id, char
         log_w(LEDA_TAG_NAME, "output: %s is invaild\n", output);
         return LE_ERROR_INVAILD_PARAM;
     }
-    else
-    {
-        object = cJSON_Parse(output);
-        if (NULL == object)
-        {
-            log_w(LEDA_TAG_NAME, "output: %s parse failed\n", output);
-            return LEDA_ERROR_INVALID_JSON;
-        }
-        cJSON_Delete(object);
-    }
-
-    path = (char *)malloc(strlen(LEDA_DEVICE_WKN) + strlen(cloud_id) + 2);
-    if (NULL == path)
-    {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        return LE_ERROR_ALLOCATING_MEM;
-    }
 
-    interface = (char *)malloc(strlen(LEDA_DEVICE_WKN) + strlen(cloud_id) + 1);
-    if (NULL == interface)
-    {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        free(path);
-        return LE_ERROR_ALLOCATING_MEM;
-    }
-    snprintf(interface, strlen(LEDA_DEVICE_WKN)+strlen(cloud_id)+1, "%s%s", LEDA_DEVICE_WKN, cloud_id);
-    leda_wkn_to_path(interface, path);
-    
-    signal_msg = dbus_message_new_signal(path, interface, signal_name);
+    signal_msg = dbus_message_new_signal(device_info->path, device_info->interface, signal_name);
     if (NULL == signal_msg)
     {
         log_w(LEDA_TAG_NAME, "create dbus new signal failed\n");
-        free(path);
-        free(interface);
         return LE_ERROR_UNKNOWN;
     }
 
@@ -293,100 +276,18 @@ static int _leda_send_signal(const char *signal_name, const char *cloud_id, char
     if (TRUE != dbus_connection_send(g_connection, signal_msg, NULL))
     {
         log_w(LEDA_TAG_NAME, "dbus send failed\n");
-        free(path);
-        free(interface);
         dbus_message_unref(signal_msg);
         return LE_ERROR_UNKNOWN;
     }
 
-    log_d(LEDA_TAG_NAME, "new_signal interface: %s signal_name: %s cloud_id: %s output: %s\n", interface, signal_name, cloud_id, output);
+    log_d(LEDA_TAG_NAME, "new_signal interface: %s signal_name: %s cloud_id: %s output: %s\n", 
+                         device_info->interface, signal_name, device_info->cloud_id, output);
 
-    free(path);
-    free(interface);
     dbus_message_unref(signal_msg);
 
     return LE_SUCCESS;
 }
 
-static int _leda_add_property_timestamp(const char *cloud_id, char *output)
-{
-    cJSON       *object       = NULL; 
-    cJSON       *item         = NULL; 
-    cJSON       *new_object   = NULL;
-    cJSON       *new_item     = NULL;
-    char        *buff         = NULL;
-    int         ret           = LE_SUCCESS;
-
-    object = cJSON_Parse(output);
-    if(NULL == object)
-    {
-        log_w(LEDA_TAG_NAME, "output: %s parse failed\n", output);
-        return LEDA_ERROR_INVALID_JSON;
-    }
-
-    new_object = cJSON_CreateObject();
-    if (NULL == new_object)
-    {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        cJSON_Delete(object);
-        return LEDA_ERROR_INVALID_JSON;
-    }
-
-    cJSON_ArrayForEach(item, object)
-    {
-        new_item = cJSON_CreateObject();
-        if (NULL == new_item)
-        {
-            log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-            break;
-        }
-
-        cJSON_AddNumberToObject(new_item, "time", _leda_get_current_time_ms());
-        if (cJSON_False == item->type)
-        {
-            cJSON_AddFalseToObject(new_item, "value");
-        }
-        else if (cJSON_True == item->type)
-        {
-            cJSON_AddTrueToObject(new_item, "value");
-        }
-        else if (cJSON_NULL == item->type)
-        {
-            cJSON_AddNullToObject(new_item, "value");
-        }
-        else if (cJSON_Number == item->type)
-        {
-            cJSON_AddNumberToObject(new_item, "value", item->valuedouble);
-        }
-        else if (cJSON_String == item->type)
-        {
-            cJSON_AddStringToObject(new_item, "value", item->valuestring);
-        }
-        else if ((cJSON_Array == item->type) || (cJSON_Object == item->type))
-        {
-            cJSON_AddItemToObject(new_item, "value", cJSON_Duplicate(item, 1));
-        }
-        else if (cJSON_Raw == item->type)
-        {
-            cJSON_AddRawToObject(new_item, "value", item->valuestring);
-        }
-        else
-        {
-            cJSON_Delete(new_item);
-            continue;
-        }
-        cJSON_AddItemToObject(new_object, item->string, new_item);
-    }
-    cJSON_Delete(object);
-
-    buff = cJSON_PrintUnformatted(new_object);
-    ret  = _leda_send_signal(LEDA_PROPERTY_CHANGED, cloud_id, buff);
-    cJSON_Delete(new_object);
-    cJSON_free(buff);
-
-    return ret;
-}
-
 /*
  * 上报属性, 设备具有的属性在设备能力描述在设备产品物模型tsl规定.
  *
@@ -402,7 +303,8 @@ static int _leda_add_property_timestamp(const char *cloud_id, char *output)
 int leda_report_properties(device_handle_t dev_handle, const leda_device_data_t properties[], int properties_count)
 {
     int                 ret             = LE_SUCCESS;
-    char*               buff            = NULL;
+    char                buff[LEDA_JSON_STACK_BUFF_SIZE];
+    leda_json_writer_t  writer;
     leda_device_info_t  *device_info    = NULL;
 
     device_info = leda_get_methodcb_by_device_handle(dev_handle);
@@ -423,68 +325,14 @@ int leda_report_properties(device_handle_t dev_handle, const leda_device_data_t
         return LE_ERROR_INVAILD_PARAM;
     }
 
-    buff = leda_transform_data_struct_to_string(properties, properties_count);
-    if (NULL == buff)
-    {
-        return LE_ERROR_ALLOCATING_MEM;
-    }
-    
-    ret = _leda_add_property_timestamp(device_info->cloud_id, buff);
-    free(buff);
-    buff = NULL;
-
-    return ret;
-}
-
-static int _leda_add_event_timestamp(const char* event_name, const char *cloud_id, char *output)
-{
-    cJSON       *object       = NULL; 
-    cJSON       *new_object   = NULL;
-    cJSON       *new_item     = NULL;
-    char        *buff         = NULL;
-    int         ret           = LE_SUCCESS;
-
-    if (NULL != output)
-    {
-        object = cJSON_Parse(output);
-        if (NULL == object)
-        {
-            log_w(LEDA_TAG_NAME, "output: %s parse failed\n", output);
-            return LEDA_ERROR_INVALID_JSON;
-        }
-    }
-    else
-    {
-        object = cJSON_Parse("{}");
-    }
-
-    new_object = cJSON_CreateObject();
-    if (NULL == new_object)
-    {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        cJSON_Delete(object);
-        return LEDA_ERROR_INVALID_JSON;
-    }
-
-    new_item = cJSON_CreateObject();
-    if (NULL == new_item)
+    /* 直接编码为{"key":{"time":..,"value":..}}, 常规大小的上报不分配内存 */
+    leda_json_writer_init(&writer, buff, sizeof(buff));
+    ret = leda_json_write_data(&writer, properties, properties_count, _leda_get_current_time_ms());
+    if (LE_SUCCESS == ret)
     {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        cJSON_Delete(new_object);
-        cJSON_Delete(object);
-        return LEDA_ERROR_INVALID_JSON;
+        ret = _leda_send_signal(LEDA_PROPERTY_CHANGED, device_info, writer.buf);
     }
-
-    cJSON_AddNumberToObject(new_item, "time", _leda_get_current_time_ms());
-    cJSON_AddItemToObject(new_item, "value", cJSON_Duplicate(object, 1));
-    cJSON_AddItemToObject(new_object, "params", new_item);
-
-    buff = cJSON_PrintUnformatted(new_object);
-    ret = _leda_send_signal(event_name, cloud_id, buff);
-
-    cJSON_Delete(object);
-    cJSON_Delete(new_object);
-    cJSON_free(buff);
+    leda_json_writer_free(&writer);
 
     return ret;
 }
@@ -504,7 +352,8 @@ static int _leda_add_event_timestamp(const char* event_name, const char *cloud_i
 int leda_report_event(device_handle_t dev_handle, const char *event_name, const leda_device_data_t data[], int data_count)
 {
     int                 ret             = LE_SUCCESS;
-    char*               buff            = NULL;
+    char                buff[LEDA_JSON_STACK_BUFF_SIZE];
+    leda_json_writer_t  writer;
     leda_device_info_t  *device_info    = NULL;
 
     if (NULL == event_name)
@@ -525,53 +374,48 @@ int leda_report_event(device_handle_t dev_handle, const char *event_name, const
         return LEDA_ERROR_DEVICE_OFFLINE;
     }
 
+    /* 直接编码为{"params":{"time":..,"value":{..}}} */
+    leda_json_writer_init(&writer, buff, sizeof(buff));
+    leda_json_write_fmt(&writer, "{\"params\":{\"time\":%lld,\"value\":", _leda_get_current_time_ms());
     if (NULL == data || 0 == data_count)
     {
-        ret = _leda_add_event_timestamp(event_name, device_info->cloud_id, NULL);
+        leda_json_write_raw(&writer, "{}", 2);
     }
     else
     {
-        buff = leda_transform_data_struct_to_string(data, data_count);
-        if (NULL == buff)
-        {
-            return LE_ERROR_ALLOCATING_MEM;
-        }
+        ret = leda_json_write_data(&writer, data, data_count, -1);
+    }
+    leda_json_write_raw(&writer, "}}", 2);
+
+    if ((LE_SUCCESS == ret) && writer.error)
+    {
+        ret = LE_ERROR_ALLOCATING_MEM;
+    }
 
-        ret = _leda_add_event_timestamp(event_name, device_info->cloud_id, buff);
-        free(buff);
-        buff = NULL;
+    if (LE_SUCCESS == ret)
+    {
+        ret = _leda_send_signal(event_name, device_info, writer.buf);
     }
+    leda_json_writer_free(&writer);
 
     return ret;
 }
 
-static device_handle_t _leda_register_and_online(const char *product_key, 
-                                                 int is_local_name, 
-                                                 const char *name, 
-                                                 const leda_device_callback_t *device_cb, 
-                                                 int is_local, 
-                                                 void *usr_data)
+/* 校验设备注册参数 */
+static int _leda_register_check(const char *product_key, const char *name, const leda_device_callback_t *device_cb)
 {
-    int                 ret;
-    cJSON               *object                     = NULL;
-    char                *info                       = NULL;
-    char                *cloud_id                   = NULL;
-    DBusMessage         *msg_call                   = NULL;
-    leda_retinfo_t      retinfo;
-    leda_device_info_t  *device_info                = NULL;    
-
     if (NULL == product_key
         || (LE_SUCCESS != leda_string_validate_utf8(product_key, strlen(product_key))))
     {
         log_w(LEDA_TAG_NAME, "product_key: %s is invalid!\n", product_key);
-        return INVALID_DEVICE_HANDLE;
+        return LE_ERROR_INVAILD_PARAM;
     }
 
     if ((NULL == name) 
         || (LE_SUCCESS != leda_string_validate_utf8(name, strlen(name))))
     {
         log_w(LEDA_TAG_NAME, "name: %s is invalid!\n", name);
-        return INVALID_DEVICE_HANDLE;
+        return LE_ERROR_INVAILD_PARAM;
     }
 
     if ((NULL == device_cb)
@@ -580,22 +424,24 @@ static device_handle_t _leda_register_and_online(const char *product_key,
         || (NULL == device_cb->call_service_cb))
     {
         log_w(LEDA_TAG_NAME, "device_cb is invalid!\n");
-        return INVALID_DEVICE_HANDLE;
+        return LE_ERROR_INVAILD_PARAM;
     }
 
-    device_info = leda_get_methodcb_by_dn_pk(product_key, name);
-    if (NULL != device_info)
-    {
-        if (STATE_ONLINE == device_info->online)
-        {   
-            return device_info->dev_handle;
-        }
-    }
+    return LE_SUCCESS;
+}
+
+/* 创建设备注册上线请求 */
+static DBusMessage *_leda_register_request_new(const char *product_key, int is_local_name, const char *name, int is_local)
+{
+    cJSON               *object                     = NULL;
+    char                *info                       = NULL;
+    DBusMessage         *msg_call                   = NULL;
 
     object = cJSON_CreateObject();
     if (NULL == object)
     {
         log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return NULL;
     }
 
     cJSON_AddStringToObject(object, "productKey",       product_key);
@@ -615,7 +461,7 @@ static device_handle_t _leda_register_and_online(const char *product_key,
     {
         log_w(LEDA_TAG_NAME, "no memory can allocate\n");
         cJSON_Delete(object);
-        return INVALID_DEVICE_HANDLE;
+        return NULL;
     }
 
     msg_call = _leda_create_methodcall(DMP_DIMU_WELL_KNOWN_NAME, DMP_METHOD_CONNECT);
@@ -624,7 +470,7 @@ static device_handle_t _leda_register_and_online(const char *product_key,
         log_w(LEDA_TAG_NAME, "create dbus method call failed\n");
         cJSON_Delete(object);
         cJSON_free(info);
-        return INVALID_DEVICE_HANDLE;
+        return NULL;
     }
 
     dbus_message_append_args(msg_call, DBUS_TYPE_STRING, &info, DBUS_TYPE_INVALID);
@@ -633,20 +479,23 @@ static device_handle_t _leda_register_and_online(const char *product_key,
     cJSON_Delete(object);
     cJSON_free(info);
 
-    retinfo.message = NULL;
-    retinfo.params = NULL;
-    ret = _leda_send_with_replay(msg_call, 10000, &retinfo);
-    dbus_message_unref(msg_call);
-    if ((LE_SUCCESS != ret) || (LE_SUCCESS != retinfo.code))
-    {
-        log_w(LEDA_TAG_NAME, "call register and online deivce method failed, ret: %d code: %d, msg: %s\n", ret, retinfo.code, retinfo.message);
-        leda_retinfo_free(&retinfo);
+    return msg_call;
+}
 
-        return INVALID_DEVICE_HANDLE;
-    }
-    
-    cloud_id = leda_params_parse(retinfo.params, "deviceCloudId");
-    leda_retinfo_free(&retinfo);
+/* 处理设备注册上线应答, 登记设备回调并申请设备WKN, 返回设备句柄 */
+static device_handle_t _leda_register_finish(const char *product_key, 
+                                             int is_local_name, 
+                                             const char *name, 
+                                             const leda_device_callback_t *device_cb, 
+                                             int is_local, 
+                                             void *usr_data, 
+                                             const char *params)
+{
+    int                 ret;
+    char                *cloud_id                   = NULL;
+    leda_device_info_t  *device_info                = NULL;    
+
+    cloud_id = leda_params_parse(params, "deviceCloudId");
     if (NULL == cloud_id)
     {
         log_w(LEDA_TAG_NAME, "parse deviceCloudId feild failed\n");
@@ -674,7 +523,7 @@ static device_handle_t _leda_register_and_online(const char *product_key,
     }
     free(cloud_id);
 
-    ret = _leda_request_wkn(LEDA_DEVICE_WKN, (char *)device_info->cloud_id);
+    ret = _leda_request_wkn(_leda_device_connection(device_info), LEDA_DEVICE_WKN, (char *)device_info->cloud_id);
     if (LE_SUCCESS != ret)
     {
         log_w(LEDA_TAG_NAME, "call request wkn method failed, ret: %d product_key: %s name: %s\n", ret, product_key, name);
@@ -687,73 +536,153 @@ static device_handle_t _leda_register_and_online(const char *product_key,
     return device_info->dev_handle;
 }
 
-/*
- * 下线设备, 假如设备工作在不正常的状态或设备退出前, 可以先下线设备, 这样LinkEdge就不会继续下发消息到设备侧.
- *
- * dev_handle:  设备在linkedge本地唯一标识.
- *
- * 阻塞接口, 成功返回LE_SUCCESS,  失败返回错误码.
- *
- */
-int leda_offline(device_handle_t dev_handle)
+static device_handle_t _leda_register_and_online(const char *product_key, 
+                                                 int is_local_name, 
+                                                 const char *name, 
+                                                 const leda_device_callback_t *device_cb, 
+                                                 int is_local, 
+                                                 void *usr_data)
 {
-    int                 ret = LE_SUCCESS;
+    int                 ret;
+    device_handle_t     dev_handle                  = INVALID_DEVICE_HANDLE;
+    DBusMessage         *msg_call                   = NULL;
     leda_retinfo_t      retinfo;
+    leda_device_info_t  *device_info                = NULL;    
+
+    if (LE_SUCCESS != _leda_register_check(product_key, name, device_cb))
+    {
+        return INVALID_DEVICE_HANDLE;
+    }
+
+    device_info = leda_get_methodcb_by_dn_pk(product_key, name);
+    if (NULL != device_info)
+    {
+        if (STATE_ONLINE == device_info->online)
+        {   
+            return device_info->dev_handle;
+        }
+    }
+
+    msg_call = _leda_register_request_new(product_key, is_local_name, name, is_local);
+    if (NULL == msg_call)
+    {
+        return INVALID_DEVICE_HANDLE;
+    }
+
+    retinfo.message = NULL;
+    retinfo.params = NULL;
+    ret = _leda_send_with_replay(msg_call, 10000, &retinfo);
+    dbus_message_unref(msg_call);
+    if ((LE_SUCCESS != ret) || (LE_SUCCESS != retinfo.code))
+    {
+        log_w(LEDA_TAG_NAME, "call register and online deivce method failed, ret: %d code: %d, msg: %s\n", ret, retinfo.code, retinfo.message);
+        leda_retinfo_free(&retinfo);
+
+        return INVALID_DEVICE_HANDLE;
+    }
+    
+    dev_handle = _leda_register_finish(product_key, is_local_name, name, device_cb, is_local, usr_data, retinfo.params);
+    leda_retinfo_free(&retinfo);
+
+    return dev_handle;
+}
+
+/* 创建以设备cloud_id为参数的设备管理请求, 如下线, 注销 */
+static DBusMessage *_leda_device_request_new(const char *method, const char *cloud_id)
+{
     DBusMessage         *msg_call       = NULL;
     cJSON               *object         = NULL;
     char                *info           = NULL;
-    leda_device_info_t  *device_info    = NULL;
 
-    device_info = leda_get_methodcb_by_device_handle(dev_handle);
-    if (NULL == device_info)
-    {
-        log_w(LEDA_TAG_NAME, "dev_handle:%d hasn't register\n", dev_handle);
-        return LE_ERROR_INVAILD_PARAM;
-    }   
-
-    msg_call = _leda_create_methodcall(DMP_DIMU_WELL_KNOWN_NAME, DMP_METHOD_DISCONNECT);
+    msg_call = _leda_create_methodcall(DMP_DIMU_WELL_KNOWN_NAME, method);
     if (NULL == msg_call)
     {
         log_w(LEDA_TAG_NAME, "create dbus method call failed\n");
-        return LE_ERROR_UNKNOWN;
+        return NULL;
     }
     
     object = cJSON_CreateObject();
     if (NULL == object)
     {
         log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        return LE_ERROR_ALLOCATING_MEM;
+        dbus_message_unref(msg_call);
+        return NULL;
     }
 
-    cJSON_AddStringToObject(object, "deviceCloudId", device_info->cloud_id);
+    cJSON_AddStringToObject(object, "deviceCloudId", cloud_id);
 
     info = cJSON_PrintUnformatted(object);
     if (NULL == info)
     {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
         cJSON_Delete(object);
         dbus_message_unref(msg_call);
-
-        return LE_ERROR_ALLOCATING_MEM;
+        return NULL;
     }
     
     dbus_message_append_args(msg_call, DBUS_TYPE_STRING, &info, DBUS_TYPE_INVALID);
     cJSON_Delete(object);
     cJSON_free(info);
 
-    ret = _leda_send_with_replay(msg_call, 10000, &retinfo);
-    dbus_message_unref(msg_call);
-    if ((LE_SUCCESS != ret) || (LE_SUCCESS != retinfo.code))
+    return msg_call;
+}
+
+/* 设备下线后的本地处理, 无论下线请求是否成功都停止接收设备请求 */
+static void _leda_offline_finish(device_handle_t dev_handle)
+{
+    leda_device_info_t  *device_info    = NULL;
+
+    device_info = leda_get_methodcb_by_device_handle(dev_handle);
+    if (NULL == device_info)
     {
-        log_w(LEDA_TAG_NAME, "call offline method failed, ret: %d code: %d msg: %s\n", ret, retinfo.code, retinfo.message);
-        ret = LE_ERROR_UNKNOWN;
-        goto END;
+        return;
     }
 
-    log_d(LEDA_TAG_NAME, "offline: %d\n", dev_handle);
-
-END:
     leda_set_methodcb_online(dev_handle, STATE_OFFLINE);
-    _leda_release_wkn(LEDA_DEVICE_WKN, device_info->cloud_id);
+    _leda_release_wkn(_leda_device_connection(device_info), LEDA_DEVICE_WKN, device_info->cloud_id);
+}
+
+/*
+ * 下线设备, 假如设备工作在不正常的状态或设备退出前, 可以先下线设备, 这样LinkEdge就不会继续下发消息到设备侧.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识.
+ *
+ * 阻塞接口, 成功返回LE_SUCCESS,  失败返回错误码.
+ *
+ */
+int leda_offline(device_handle_t dev_handle)
+{
+    int                 ret = LE_SUCCESS;
+    leda_retinfo_t      retinfo;
+    DBusMessage         *msg_call       = NULL;
+    leda_device_info_t  *device_info    = NULL;
+
+    device_info = leda_get_methodcb_by_device_handle(dev_handle);
+    if (NULL == device_info)
+    {
+        log_w(LEDA_TAG_NAME, "dev_handle:%d hasn't register\n", dev_handle);
+        return LE_ERROR_INVAILD_PARAM;
+    }   
+
+    msg_call = _leda_device_request_new(DMP_METHOD_DISCONNECT, device_info->cloud_id);
+    if (NULL == msg_call)
+    {
+        return LE_ERROR_UNKNOWN;
+    }
+
+    ret = _leda_send_with_replay(msg_call, 10000, &retinfo);
+    dbus_message_unref(msg_call);
+    if ((LE_SUCCESS != ret) || (LE_SUCCESS != retinfo.code))
+    {
+        log_w(LEDA_TAG_NAME, "call offline method failed, ret: %d code: %d msg: %s\n", ret, retinfo.code, retinfo.message);
+        ret = LE_ERROR_UNKNOWN;
+        goto END;
+    }
+
+    log_d(LEDA_TAG_NAME, "offline: %d\n", dev_handle);
+
+END:
+    _leda_offline_finish(dev_handle);
     leda_retinfo_free(&retinfo);
 
     return ret;
@@ -886,8 +815,6 @@ device_handle_t leda_register_and_online_by_local_name(const char *product_key,
 int leda_unregister(device_handle_t dev_handle)
 {
     int                 ret             = LE_SUCCESS;
-    cJSON               *object         = NULL;
-    char                *info           = NULL;
     leda_retinfo_t      retinfo;
     DBusMessage         *msg_call       = NULL;
     leda_device_info_t  *device_info    = NULL;
@@ -903,33 +830,11 @@ int leda_unregister(device_handle_t dev_handle)
         leda_offline(device_info->dev_handle);
     }
     
-    msg_call = _leda_create_methodcall(DMP_DIMU_WELL_KNOWN_NAME, DMP_METHOD_UNREGISTER_DEVICE);
+    msg_call = _leda_device_request_new(DMP_METHOD_UNREGISTER_DEVICE, device_info->cloud_id);
     if (NULL == msg_call)
     {
-        log_w(LEDA_TAG_NAME, "create dbus method call failed\n");
         return LE_ERROR_UNKNOWN;
     }
-    
-    object = cJSON_CreateObject();
-    if (NULL == object)
-    {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        return LE_ERROR_ALLOCATING_MEM;
-    }
-
-    cJSON_AddStringToObject(object, "deviceCloudId", device_info->cloud_id);
-
-    info = cJSON_PrintUnformatted(object);
-    if (NULL == info)
-    {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        cJSON_Delete(object);
-        return LE_ERROR_ALLOCATING_MEM;
-    }
-
-    dbus_message_append_args(msg_call, DBUS_TYPE_STRING, &info, DBUS_TYPE_INVALID);
-    cJSON_Delete(object);
-    cJSON_free(info);
 
     retinfo.message = NULL;
     retinfo.params = NULL;
@@ -1102,11 +1007,140 @@ static int _leda_register_driver(const char *module_name)
  *
  * 阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
  */
-static int _leda_init(const char *module_id, const char *module_name, int worker_thread_nums)
+static int _leda_check_thread_sched(const leda_thread_sched_t *sched)
+{
+    if ((SCHED_OTHER != sched->sched_policy) 
+        && (SCHED_FIFO != sched->sched_policy) 
+        && (SCHED_RR != sched->sched_policy))
+    {
+        log_w(LEDA_TAG_NAME, "sched_policy: %d is invalid\n", sched->sched_policy);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((SCHED_OTHER != sched->sched_policy) 
+        && ((sched->sched_priority < sched_get_priority_min(sched->sched_policy)) 
+            || (sched->sched_priority > sched_get_priority_max(sched->sched_policy))))
+    {
+        log_w(LEDA_TAG_NAME, "sched_priority: %d is invalid\n", sched->sched_priority);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((sched->nice < -20) || (sched->nice > 19))
+    {
+        log_w(LEDA_TAG_NAME, "nice: %d is invalid\n", sched->nice);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    return LE_SUCCESS;
+}
+
+/* 打开一个分片连接, 使用私有连接, 避免与主连接复用同一个共享连接 */
+static DBusConnection *_leda_open_shard_connection(void)
+{
+    DBusError       dbus_error;
+    DBusConnection  *connection = NULL;
+
+    dbus_error_init(&dbus_error);
+    connection = dbus_connection_open_private(bus_address, &dbus_error);
+    if (NULL == connection)
+    {
+        log_w(LEDA_TAG_NAME, "dbus connection failed: %s\n", dbus_error.message);
+        dbus_error_free(&dbus_error);
+        return NULL;
+    }
+
+    if ((TRUE != dbus_bus_register(connection, &dbus_error)) 
+        || (dbus_error_is_set(&dbus_error)))
+    {
+        log_w(LEDA_TAG_NAME, "register dbus failed: %s\n", dbus_error.message);
+        dbus_error_free(&dbus_error);
+        dbus_connection_close(connection);
+        dbus_connection_unref(connection);
+        return NULL;
+    }
+    dbus_error_free(&dbus_error);
+
+    return connection;
+}
+
+/* 初始化连接的事件循环并启动消息分发线程 */
+static int _leda_start_dispatcher(int index, DBusConnection *connection, const leda_init_config_t *config)
+{
+    leda_connect_info_t *connect_info = NULL;
+
+    connect_info = (leda_connect_info_t *)malloc(sizeof(leda_connect_info_t));
+    if (NULL == connect_info)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    connect_info->config     = *config;
+    connect_info->connection = connection;
+    connect_info->index      = index;
+
+    if (LE_SUCCESS != leda_mainloop_init(&(connect_info->mainloop), connection))
+    {
+        free(connect_info);
+        return LE_ERROR_UNKNOWN;
+    }
+
+    if (0 != pthread_create(&(connect_info->thread_id), NULL, leda_methodcb_thread, (void *)connect_info))
+    {
+        log_w(LEDA_TAG_NAME, "create thread failed\n");
+        leda_mainloop_destroy(&(connect_info->mainloop));
+        free(connect_info);
+        return LE_ERROR_UNKNOWN;
+    }
+
+    g_connect_info[index] = connect_info;
+
+    return LE_SUCCESS;
+}
+
+/* 通知消息分发线程退出并等待其结束 */
+static void _leda_join_dispatchers(void)
+{
+    int i = 0;
+
+    leda_set_runstate(RUN_STATE_EXIT);
+    for (i = 0; i < g_connection_nums; i++)
+    {
+        leda_mainloop_wakeup(&(g_connect_info[i]->mainloop));
+    }
+
+    for (i = 0; i < g_connection_nums; i++)
+    {
+        pthread_join(g_connect_info[i]->thread_id, NULL);
+    }
+}
+
+/* 确保应答全部发出后再释放连接, 主连接为共享连接不关闭 */
+static void _leda_close_connections(void)
+{
+    int i = 0;
+
+    for (i = 0; i < g_connection_nums; i++)
+    {
+        dbus_connection_flush(g_connect_info[i]->connection);
+        leda_mainloop_destroy(&(g_connect_info[i]->mainloop));
+        if (0 != i)
+        {
+            dbus_connection_close(g_connect_info[i]->connection);
+            dbus_connection_unref(g_connect_info[i]->connection);
+        }
+        free(g_connect_info[i]);
+        g_connect_info[i] = NULL;
+    }
+    g_connection_nums = 0;
+}
+
+static int _leda_init(const char *module_id, const char *module_name, const leda_init_config_t *config)
 {
     DBusError           dbus_error;
     cJSON_Hooks         json_hooks;
-    leda_connect_info_t *connect_info = NULL;
+    DBusConnection      *connection     = NULL;
+    int                 connection_nums = 0;
+    int                 i               = 0;
 
     log_d(LEDA_TAG_NAME, "driver info:     \n\
                           driver_id:   %s  \n\
@@ -1119,13 +1153,71 @@ static int _leda_init(const char *module_id, const char *module_name, int worker
         return LE_ERROR_INVAILD_PARAM;
     }
 
-    if (worker_thread_nums <= 0)
+    if (config->worker_thread_nums <= 0)
+    {
+        log_w(LEDA_TAG_NAME, "worker_thread_nums: %d is invalid\n", config->worker_thread_nums);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((config->pool_mode < LEDA_POOL_MODE_SHARED) || (config->pool_mode >= LEDA_POOL_MODE_BUTT))
+    {
+        log_w(LEDA_TAG_NAME, "pool_mode: %d is invalid\n", config->pool_mode);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if (config->request_timeout_ms < 0)
+    {
+        log_w(LEDA_TAG_NAME, "request_timeout_ms: %d is invalid\n", config->request_timeout_ms);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((config->connection_nums < 0) || (config->connection_nums > LEDA_MAX_CONNECTION_NUMS))
+    {
+        log_w(LEDA_TAG_NAME, "connection_nums: %d is invalid\n", config->connection_nums);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if (config->tsl_cache_max_bytes < 0)
+    {
+        log_w(LEDA_TAG_NAME, "tsl_cache_max_bytes: %d is invalid\n", config->tsl_cache_max_bytes);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if (config->shutdown_timeout_ms < 0)
+    {
+        log_w(LEDA_TAG_NAME, "shutdown_timeout_ms: %d is invalid\n", config->shutdown_timeout_ms);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((config->min_thread_nums < 0) 
+        || (config->min_thread_nums > config->worker_thread_nums)
+        || (config->thread_spawn_wait_ms < 0)
+        || (config->thread_idle_timeout_ms < 0)
+        || ((config->thread_stack_size > 0) && (config->thread_stack_size < PTHREAD_STACK_MIN))
+        || (config->thread_stack_size < 0))
+    {
+        log_w(LEDA_TAG_NAME, "thread config is invalid, min_thread_nums: %d, spawn_wait: %d, idle_timeout: %d, stack_size: %d\n", 
+                             config->min_thread_nums, 
+                             config->thread_spawn_wait_ms, 
+                             config->thread_idle_timeout_ms, 
+                             config->thread_stack_size);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((LE_SUCCESS != _leda_check_thread_sched(&(config->dispatcher_sched)))
+        || (LE_SUCCESS != _leda_check_thread_sched(&(config->worker_sched))))
+    {
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((config->max_queue_size < 0) || (config->queue_high_watermark < 0))
     {
-        log_w(LEDA_TAG_NAME, "worker_thread_nums: %d is invalid\n", worker_thread_nums);
+        log_w(LEDA_TAG_NAME, "max_queue_size: %d or queue_high_watermark: %d is invalid\n", 
+                             config->max_queue_size, config->queue_high_watermark);
         return LE_ERROR_INVAILD_PARAM;
     }
 
-    log_d(LEDA_TAG_NAME, "worker_thread_nums: %d\n", worker_thread_nums);
+    log_d(LEDA_TAG_NAME, "worker_thread_nums: %d, pool_mode: %d\n", config->worker_thread_nums, config->pool_mode);
 
     dbus_error_init(&dbus_error);
     g_connection = dbus_connection_open(bus_address, &dbus_error);
@@ -1154,30 +1246,52 @@ static int _leda_init(const char *module_id, const char *module_name, int worker
         return LE_ERROR_UNKNOWN;
     }
 
-    if (LE_SUCCESS != _leda_request_wkn(LEDA_DRIVER_WKN, module_id))
+    if (LE_SUCCESS != _leda_request_wkn(g_connection, LEDA_DRIVER_WKN, module_id))
     {
         return LE_ERROR_UNKNOWN;
     }
 
-    connect_info = (leda_connect_info_t *)malloc(sizeof(leda_connect_info_t));
-    if (NULL == connect_info)
-    {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        return LE_ERROR_ALLOCATING_MEM;
-    }
-    connect_info->trpool_num = worker_thread_nums;
-    connect_info->connection = g_connection;
-
     pthread_mutex_init(&g_methodcb_list_lock, NULL);
     pthread_mutex_init(&g_leda_reply_lock, NULL);
     pthread_mutex_init(&g_device_configcb_lock, NULL);
-    
-    if (0 != pthread_create(&g_methodcb_thread_id, NULL, leda_methodcb_thread, (void *)connect_info))
+    leda_reply_init();
+    leda_tsl_cache_init(config->tsl_cache_max_bytes, &_leda_tsl_subscribe);
+
+    if (LE_SUCCESS != leda_pool_init(config))
     {
-        log_w(LEDA_TAG_NAME, "create thread failed\n");
+        log_e(LEDA_TAG_NAME, "thread pool init failed\n");
         return LE_ERROR_UNKNOWN;
     }
 
+    /* 主连接承载驱动WKN和所有同步调用, 其余连接只承载按cloud_id分片的设备WKN */
+    connection_nums = (config->connection_nums > 0) ? config->connection_nums : 1;
+    for (i = 0; i < connection_nums; i++)
+    {
+        connection = (0 == i) ? g_connection : _leda_open_shard_connection();
+        if ((NULL == connection) || (LE_SUCCESS != _leda_start_dispatcher(i, connection, config)))
+        {
+            log_w(LEDA_TAG_NAME, "start dispatcher: %d failed\n", i);
+            if ((NULL != connection) && (0 != i))
+            {
+                dbus_connection_close(connection);
+                dbus_connection_unref(connection);
+            }
+
+            /* 停止已启动的消息分发线程并关闭其连接, 运行状态复位后可重新初始化 */
+            _leda_join_dispatchers();
+            if (LE_SUCCESS == leda_pool_destroy())
+            {
+                _leda_close_connections();
+            }
+            leda_set_runstate(RUN_STATE_NORMAL);
+
+            return LE_ERROR_UNKNOWN;
+        }
+
+        /* 分发线程启动后才计入, 失败时只回收已启动的部分 */
+        g_connection_nums = i + 1;
+    }
+
     json_hooks.malloc_fn = malloc;
     json_hooks.free_fn = free;
     cJSON_InitHooks(&json_hooks);
@@ -1185,10 +1299,6 @@ static int _leda_init(const char *module_id, const char *module_name, int worker
     if (LE_SUCCESS != _leda_register_driver(module_name))
     {
         log_w(LEDA_TAG_NAME, "register driver: %s failed\n", module_name);
-
-        free(connect_info);
-        connect_info = NULL;
-
         return LE_ERROR_UNKNOWN;
     }
 
@@ -1218,34 +1328,86 @@ static int _leda_init(const char *module_id, const char *module_name, int worker
  *
  * worker_thread_nums : 线程池工作线程数, 该数值根据注册设备数量进行设置.
  *
+ * 同一设备的请求按到达顺序串行执行, 不同设备的请求在工作线程间并行执行, 设备回调内无需为并发加锁.
+ * 不同设备的请求按类型区分优先级: 配置变更通知 > 属性获取 > 属性设置 > 服务调用.
+ *
  * 阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
  */
 int leda_init(int worker_thread_nums)
 {
+    leda_init_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    config.worker_thread_nums = worker_thread_nums;
+    config.pool_mode          = LEDA_POOL_MODE_SHARED;
+
+    return leda_init_ex(&config);
+}
+
+/*
+ * 驱动模块初始化, 功能同leda_init, 通过config指定线程池等扩展配置.
+ *
+ * config: 初始化配置, 详细描述见@leda_init_config.
+ *
+ * 阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_init_ex(const leda_init_config_t *config)
+{
+    if (NULL == config)
+    {
+        log_w(LEDA_TAG_NAME, "config is null\n");
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
     if (NULL == getenv("FUNCTION_ID") || NULL == getenv("FUNCTION_NAME"))
     {
         log_w(LEDA_TAG_NAME, "the driver is not deployed, check it please\n");
         return LE_ERROR_INVAILD_PARAM;
     }
 
-    return _leda_init(getenv("FUNCTION_ID"), getenv("FUNCTION_NAME"), worker_thread_nums);
+    return _leda_init(getenv("FUNCTION_ID"), getenv("FUNCTION_NAME"), config);
 }
 
 /*
  * 模块退出.
  *
  * 模块退出前, 释放资源.
+ * 消息分发线程退出前排空线程池, 最长等待shutdown_timeout_ms, 之后剩余请求快速失败.
  *
  * 阻塞接口.
  */
 void leda_exit(void)
 {
+    int i = 0;
+
     log_i(LEDA_TAG_NAME, "driver exit\n");
 
     _leda_unregister_driver(g_module_name);
+
+    /* 排空期间消息分发线程继续运行: 新请求直接回复错误, 任务中的同步调用仍能收到应答 */
+    leda_pool_drain();
+
+    /* 进入退出状态后拒绝新的异步调用, 未完成的异步调用在连接和线程池仍存在时以失败结束 */
     leda_set_runstate(RUN_STATE_EXIT);
+    leda_reply_fail_async();
+    _leda_join_dispatchers();
+
+    /* 仍有任务阻塞在回调中时, 连接, 应答表, 物模型缓存和互斥量可能仍被其使用, 只发出应答不释放 */
+    if (LE_ERROR_TIMEOUT == leda_pool_destroy())
+    {
+        log_e(LEDA_TAG_NAME, "thread pool destroy timeout, leave shared resources\n");
+        for (i = 0; i < g_connection_nums; i++)
+        {
+            dbus_connection_flush(g_connect_info[i]->connection);
+        }
+
+        return;
+    }
+
+    _leda_close_connections();
 
-    pthread_join(g_methodcb_thread_id, NULL);
+    leda_reply_destroy();
+    leda_tsl_cache_destroy();
     pthread_mutex_destroy(&g_methodcb_list_lock);
     pthread_mutex_destroy(&g_leda_reply_lock);
     pthread_mutex_destroy(&g_device_configcb_lock);
@@ -2176,6 +2338,1015 @@ int leda_feed_watchdog(const char *module_id, const char *thread_name, int count
     return LE_SUCCESS;
 }
 
+/*
+ * 获取线程池统计信息, 用于区分请求耗时是在线程池排队还是在设备回调中.
+ *
+ * stats: 统计信息, 详细描述见@leda_pool_stats.
+ *
+ * 非阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_get_pool_stats(leda_pool_stats_t *stats)
+{
+    if (NULL == stats)
+    {
+        log_w(LEDA_TAG_NAME, "stats is null\n");
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if (LE_SUCCESS != leda_pool_get_stats(stats))
+    {
+        return LE_ERROR_UNKNOWN;
+    }
+    leda_get_reply_stats(stats);
+
+    return LE_SUCCESS;
+}
+
+/*
+ * 设置设备标志.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识.
+ * flags:       设备标志, LEDA_DEVICE_FLAG_*按位或, 0表示清除所有标志.
+ *
+ * 非阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_set_device_flags(device_handle_t dev_handle, int flags)
+{
+    leda_device_info_t *device_info = NULL;
+
+    if (0 != (flags & ~LEDA_DEVICE_FLAG_NONBLOCKING_GET))
+    {
+        log_w(LEDA_TAG_NAME, "flags: 0x%x is invalid\n", flags);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    device_info = leda_get_methodcb_by_device_handle(dev_handle);
+    if (NULL == device_info)
+    {
+        log_w(LEDA_TAG_NAME, "dev_handle: %d hasn't register\n", dev_handle);
+        return LEDA_ERROR_DEVICE_UNREGISTER;
+    }
+    device_info->flags = flags;
+
+    return LE_SUCCESS;
+}
+
+/* 异步接口调用上下文 */
+typedef struct leda_async_ctx leda_async_ctx_t;
+
+/* 异步请求应答处理, 在SDK线程中执行, 负责最终通过_leda_async_deliver回调用户 */
+typedef void (*leda_async_finish)(leda_async_ctx_t *ctx, int ret, const leda_retinfo_t *retinfo);
+
+struct leda_async_ctx
+{
+    leda_async_finish           finish;             /* 应答处理 */
+    const char                  *method;            /* 请求方法名, 用于解析应答 */
+    int                         ret;                /* 调用结果 */
+    device_handle_t             dev_handle;         /* 设备句柄 */
+    leda_device_result_callback device_result_cb;   /* 设备类接口完成回调 */
+    leda_config_result_callback config_result_cb;   /* 配置类接口完成回调 */
+    void                        *cb_data;           /* 用户私有数据 */
+    char                        *value;             /* 配置类接口获取到的内容 */
+    char                        *retry_key;         /* 获取驱动配置失败后重试使用的驱动名称 */
+    char                        *product_key;       /* 设备注册参数 */
+    char                        *name;
+    int                         is_local_name;
+    int                         is_local;
+    leda_device_callback_t      device_cb;
+    void                        *usr_data;
+    int                         direct;             /* 非0时不经过执行器直接回调, 用于SDK内部等待异步结果 */
+};
+
+static leda_executor_callback   g_async_executor      = NULL;   /* 异步接口回调执行器, NULL表示在SDK线程中直接回调 */
+static void                     *g_async_executor_data = NULL;
+static pthread_mutex_t          g_async_executor_lock = PTHREAD_MUTEX_INITIALIZER;  /* 保证执行器和私有数据成对读写 */
+
+static char *_leda_async_strdup(const char *src)
+{
+    char *dst = NULL;
+
+    dst = (char *)malloc(strlen(src) + 1);
+    if (NULL == dst)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return NULL;
+    }
+    memcpy(dst, src, strlen(src) + 1);
+
+    return dst;
+}
+
+static leda_async_ctx_t *_leda_async_ctx_new(leda_device_result_callback device_result_cb, 
+                                             leda_config_result_callback config_result_cb, 
+                                             void *cb_data)
+{
+    leda_async_ctx_t *ctx = NULL;
+
+    ctx = (leda_async_ctx_t *)calloc(1, sizeof(leda_async_ctx_t));
+    if (NULL == ctx)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return NULL;
+    }
+    ctx->dev_handle         = INVALID_DEVICE_HANDLE;
+    ctx->device_result_cb   = device_result_cb;
+    ctx->config_result_cb   = config_result_cb;
+    ctx->cb_data            = cb_data;
+
+    return ctx;
+}
+
+static void _leda_async_ctx_free(leda_async_ctx_t *ctx)
+{
+    if (NULL != ctx->value)
+    {
+        free(ctx->value);
+    }
+
+    if (NULL != ctx->retry_key)
+    {
+        free(ctx->retry_key);
+    }
+
+    if (NULL != ctx->product_key)
+    {
+        free(ctx->product_key);
+    }
+
+    if (NULL != ctx->name)
+    {
+        free(ctx->name);
+    }
+
+    free(ctx);
+}
+
+static void _leda_async_deliver_proc(void *arg)
+{
+    leda_async_ctx_t *ctx = (leda_async_ctx_t *)arg;
+
+    if (NULL != ctx->device_result_cb)
+    {
+        ctx->device_result_cb(ctx->dev_handle, ctx->ret, ctx->cb_data);
+    }
+    else if (NULL != ctx->config_result_cb)
+    {
+        ctx->config_result_cb(ctx->ret, ctx->value, ctx->cb_data);
+    }
+
+    _leda_async_ctx_free(ctx);
+}
+
+/* 回调用户并释放上下文, 设置了执行器时投递到执行器中执行 */
+static void _leda_async_deliver(leda_async_ctx_t *ctx, int ret)
+{
+    leda_executor_callback  executor        = NULL;
+    void                    *executor_data  = NULL;
+
+    ctx->ret = ret;
+    if (!ctx->direct)
+    {
+        pthread_mutex_lock(&g_async_executor_lock);
+        executor      = g_async_executor;
+        executor_data = g_async_executor_data;
+        pthread_mutex_unlock(&g_async_executor_lock);
+    }
+
+    if (NULL != executor)
+    {
+        executor(&_leda_async_deliver_proc, (void *)ctx, executor_data);
+        return;
+    }
+
+    _leda_async_deliver_proc((void *)ctx);
+}
+
+static void *_leda_async_deliver_task(void *arg)
+{
+    leda_async_ctx_t *ctx = (leda_async_ctx_t *)arg;
+
+    _leda_async_deliver(ctx, ctx->ret);
+
+    return NULL;
+}
+
+/* 请求无需发出即可完成时, 投递到线程池回调, 保证回调不在接口返回前执行; 内部等待的上下文直接回调 */
+static int _leda_async_deliver_later(leda_async_ctx_t *ctx, int ret)
+{
+    CThread_task_attr attr;
+
+    ctx->ret = ret;
+    if (ctx->direct)
+    {
+        _leda_async_deliver_proc((void *)ctx);
+        return LE_SUCCESS;
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.priority = LEDA_POOL_PRIO_CONTROL;
+
+    return leda_pool_add_task(&attr, &_leda_async_deliver_task, (void *)ctx);
+}
+
+static void _leda_async_reply(DBusMessage *reply, int ret, void *arg)
+{
+    leda_async_ctx_t    *ctx = (leda_async_ctx_t *)arg;
+    leda_retinfo_t      retinfo;
+
+    leda_retmsg_init(&retinfo);
+    if (LE_SUCCESS == ret)
+    {
+        ret = leda_retmsg_parse(reply, ctx->method, &retinfo);
+    }
+
+    ctx->finish(ctx, ret, &retinfo);
+    leda_retinfo_free(&retinfo);
+}
+
+/* 发送异步请求, 成功后上下文由应答处理负责释放, 失败时由调用者释放 */
+static int _leda_send_async(DBusMessage *msg_call, const char *method, leda_async_finish finish, leda_async_ctx_t *ctx)
+{
+    int         ret = LE_SUCCESS;
+    uint32_t    serial_id;
+
+    if (RUN_STATE_EXIT == leda_get_runstate())
+    {
+        log_w(LEDA_TAG_NAME, "driver is exiting, %s rejected\n", method);
+        return LE_ERROR_UNKNOWN;
+    }
+
+    ctx->method = method;
+    ctx->finish = finish;
+    if (FALSE == dbus_connection_send(g_connection, msg_call, &serial_id))
+    {
+        log_w(LEDA_TAG_NAME, "dbus send failed\n");
+        return LE_ERROR_UNKNOWN;
+    }
+
+    ret = leda_insert_async_reply(serial_id, 10000, &_leda_async_reply, (void *)ctx);
+    if (LE_SUCCESS != ret)
+    {
+        log_w(LEDA_TAG_NAME, "serial_id: %d insert failed\n", serial_id);
+        return ret;
+    }
+
+    /* 唤醒主连接的分发线程, 按新的超时时间重新等待 */
+    leda_mainloop_wakeup(&(g_connect_info[0]->mainloop));
+
+    return LE_SUCCESS;
+}
+
+static int _leda_device_send_async(const char *method, const char *cloud_id, leda_async_finish finish, leda_async_ctx_t *ctx)
+{
+    int         ret         = LE_SUCCESS;
+    DBusMessage *msg_call   = NULL;
+
+    msg_call = _leda_device_request_new(method, cloud_id);
+    if (NULL == msg_call)
+    {
+        return LE_ERROR_UNKNOWN;
+    }
+
+    ret = _leda_send_async(msg_call, method, finish, ctx);
+    dbus_message_unref(msg_call);
+
+    return ret;
+}
+
+/*
+ * 设置异步接口回调执行器.
+ *
+ * executor:        回调执行器, NULL表示在SDK线程中直接回调.
+ * executor_data:   执行器私有数据.
+ *
+ * 非阻塞接口, 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_set_async_executor(leda_executor_callback executor, void *executor_data)
+{
+    pthread_mutex_lock(&g_async_executor_lock);
+    g_async_executor_data = executor_data;
+    g_async_executor      = executor;
+    pthread_mutex_unlock(&g_async_executor_lock);
+
+    return LE_SUCCESS;
+}
+
+static void _leda_register_async_finish(leda_async_ctx_t *ctx, int ret, const leda_retinfo_t *retinfo)
+{
+    device_handle_t dev_handle = INVALID_DEVICE_HANDLE;
+
+    if ((LE_SUCCESS != ret) || (LE_SUCCESS != retinfo->code))
+    {
+        log_w(LEDA_TAG_NAME, "call register and online deivce method failed, ret: %d code: %d, msg: %s\n", ret, retinfo->code, retinfo->message);
+        _leda_async_deliver(ctx, (LE_ERROR_TIMEOUT == ret) ? ret : LE_ERROR_UNKNOWN);
+        return;
+    }
+
+    dev_handle = _leda_register_finish(ctx->product_key, 
+                                       ctx->is_local_name, 
+                                       ctx->name, 
+                                       &ctx->device_cb, 
+                                       ctx->is_local, 
+                                       ctx->usr_data, 
+                                       retinfo->params);
+    if (0 > dev_handle)
+    {
+        _leda_async_deliver(ctx, LE_ERROR_UNKNOWN);
+        return;
+    }
+
+    ctx->dev_handle = dev_handle;
+    _leda_async_deliver(ctx, LE_SUCCESS);
+}
+
+static int _leda_register_and_online_async(const char *product_key, 
+                                           int is_local_name, 
+                                           const char *name, 
+                                           const leda_device_callback_t *device_cb, 
+                                           int is_local, 
+                                           void *usr_data, 
+                                           device_handle_t dev_handle, 
+                                           leda_device_result_callback result_cb, 
+                                           void *cb_data, 
+                                           int direct)
+{
+    int                 ret         = LE_SUCCESS;
+    DBusMessage         *msg_call   = NULL;
+    leda_async_ctx_t    *ctx        = NULL;
+    leda_device_info_t  *device_info = NULL;
+
+    if (NULL == result_cb)
+    {
+        log_w(LEDA_TAG_NAME, "result_cb is NULL\n");
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    ret = _leda_register_check(product_key, name, device_cb);
+    if (LE_SUCCESS != ret)
+    {
+        return ret;
+    }
+
+    ctx = _leda_async_ctx_new(result_cb, NULL, cb_data);
+    if (NULL == ctx)
+    {
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    ctx->dev_handle = dev_handle;
+    ctx->direct     = direct;
+
+    device_info = leda_get_methodcb_by_dn_pk(product_key, name);
+    if ((NULL != device_info) && (STATE_ONLINE == device_info->online))
+    {
+        ctx->dev_handle = device_info->dev_handle;
+        ret = _leda_async_deliver_later(ctx, LE_SUCCESS);
+        if (LE_SUCCESS != ret)
+        {
+            _leda_async_ctx_free(ctx);
+        }
+
+        return ret;
+    }
+
+    ctx->product_key    = _leda_async_strdup(product_key);
+    ctx->name           = _leda_async_strdup(name);
+    ctx->is_local_name  = is_local_name;
+    ctx->is_local       = is_local;
+    ctx->device_cb      = *device_cb;
+    ctx->usr_data       = usr_data;
+    if ((NULL == ctx->product_key) || (NULL == ctx->name))
+    {
+        _leda_async_ctx_free(ctx);
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    msg_call = _leda_register_request_new(product_key, is_local_name, name, is_local);
+    if (NULL == msg_call)
+    {
+        _leda_async_ctx_free(ctx);
+        return LE_ERROR_UNKNOWN;
+    }
+
+    ret = _leda_send_async(msg_call, DMP_METHOD_CONNECT, &_leda_register_async_finish, ctx);
+    dbus_message_unref(msg_call);
+    if (LE_SUCCESS != ret)
+    {
+        _leda_async_ctx_free(ctx);
+    }
+
+    return ret;
+}
+
+/*
+ * 通过已在阿里云物联网平台创建的设备device_name, 注册并上线设备, 异步接口.
+ *
+ * product_key: 在阿里云物联网平台创建的产品ProductKey.
+ * device_name: 在阿里云物联网平台创建的设备DeviceName.
+ * device_cb:   请求调用设备回调函数结构体，详细描述见@leda_device_callback.
+ * usr_data:    设备注册时传入私有数据, 在回调中会传给设备.
+ * result_cb:   完成回调, 成功时dev_handle为设备在linkedge本地唯一标识.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_register_and_online_by_device_name_async(const char *product_key, 
+                                                  const char *device_name, 
+                                                  leda_device_callback_t *device_cb, 
+                                                  void *usr_data, 
+                                                  leda_device_result_callback result_cb, 
+                                                  void *cb_data)
+{
+    return _leda_register_and_online_async(product_key, 0, device_name, device_cb, 0, usr_data, INVALID_DEVICE_HANDLE, result_cb, cb_data, 0);
+}
+
+/*
+ * 通过本地自定义设备名称, 注册并上线设备, 异步接口.
+ *
+ * product_key: 在阿里云物联网平台创建的产品ProductKey.
+ * local_name:  由设备特征值组成的唯一描述信息, 必须保证同一个product_key时，每个设备名称不同.
+ * device_cb:   请求调用设备回调函数结构体，详细描述见@leda_device_callback.
+ * usr_data:    设备注册时传入私有数据, 在回调中会传给设备.
+ * result_cb:   完成回调, 成功时dev_handle为设备在linkedge本地唯一标识.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_register_and_online_by_local_name_async(const char *product_key, 
+                                                 const char *local_name, 
+                                                 leda_device_callback_t *device_cb, 
+                                                 void *usr_data, 
+                                                 leda_device_result_callback result_cb, 
+                                                 void *cb_data)
+{
+    return _leda_register_and_online_async(product_key, 1, local_name, device_cb, 0, usr_data, INVALID_DEVICE_HANDLE, result_cb, cb_data, 0);
+}
+
+/*
+ * 上线设备, 异步接口.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识.
+ * result_cb:   完成回调.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_online_async(device_handle_t dev_handle, leda_device_result_callback result_cb, void *cb_data)
+{
+    leda_device_info_t      *device_info    = NULL;
+    leda_device_callback_t  device_cb;
+
+    device_info = leda_get_methodcb_by_device_handle(dev_handle);
+    if (NULL == device_info)
+    {
+        log_w(LEDA_TAG_NAME, "dev_handle: %d hasn't register\n", dev_handle);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    device_cb.get_properties_cb         = device_info->get_properties_cb;
+    device_cb.set_properties_cb         = device_info->set_properties_cb;
+    device_cb.call_service_cb           = device_info->call_service_cb;
+    device_cb.service_output_max_count  = device_info->service_output_max_count;
+
+    return _leda_register_and_online_async(device_info->product_key, 
+                                           device_info->is_local_name, 
+                                           device_info->dev_name, 
+                                           &device_cb, 
+                                           device_info->is_local, 
+                                           device_info->usr_data, 
+                                           dev_handle, 
+                                           result_cb, 
+                                           cb_data, 
+                                           0);
+}
+
+/* 批量注册状态, 限制同时等待应答的请求数 */
+typedef struct leda_register_batch
+{
+    pthread_mutex_t             lock;
+    pthread_cond_t              done;           /* 有请求完成时通知 */
+    int                         inflight;       /* 已发出未完成的请求数 */
+    device_handle_t             *handles;       /* 各设备注册结果 */
+} leda_register_batch_t;
+
+typedef struct leda_register_batch_item
+{
+    leda_register_batch_t       *batch;
+    int                         index;          /* 设备在批量注册数组中的位置 */
+} leda_register_batch_item_t;
+
+static void _leda_register_batch_cb(device_handle_t dev_handle, int ret, void *cb_data)
+{
+    leda_register_batch_item_t  *item   = (leda_register_batch_item_t *)cb_data;
+    leda_register_batch_t       *batch  = item->batch;
+
+    pthread_mutex_lock(&batch->lock);
+    batch->handles[item->index] = (LE_SUCCESS == ret) ? dev_handle : INVALID_DEVICE_HANDLE;
+    batch->inflight--;
+    pthread_cond_signal(&batch->done);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/*
+ * 批量注册并上线设备.
+ *
+ * devices:     待注册设备数组, 详细描述见@leda_device_register_info.
+ * count:       设备个数.
+ * handles:     输出各设备在linkedge本地唯一标识, 注册失败的设备为INVALID_DEVICE_HANDLE, 数组长度不小于count.
+ * window:      同时等待应答的最大请求数, 小于等于0时使用LEDA_REGISTER_WINDOW_DEFAULT.
+ *
+ * 阻塞接口, 返回注册成功的设备个数, 参数错误返回错误码.
+ * 注: 在设备回调等线程池工作线程中调用时逐个同步注册, 不等待需线程池执行的异步完成, 避免线程耗尽时死锁.
+ */
+int leda_register_and_online_batch(const leda_device_register_info_t devices[], int count, device_handle_t handles[], int window)
+{
+    int                         ret     = LE_SUCCESS;
+    int                         i       = 0;
+    int                         success = 0;
+    leda_register_batch_t       batch;
+    leda_register_batch_item_t  *items  = NULL;
+
+    if ((NULL == devices) || (NULL == handles) || (0 >= count))
+    {
+        log_w(LEDA_TAG_NAME, "devices: %p handles: %p count: %d is invalid\n", devices, handles, count);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if (0 >= window)
+    {
+        window = LEDA_REGISTER_WINDOW_DEFAULT;
+    }
+
+    /* 同步调用的应答由分发线程直接唤醒, 不依赖线程池 */
+    if (leda_pool_in_worker())
+    {
+        for (i = 0; i < count; i++)
+        {
+            handles[i] = _leda_register_and_online(devices[i].product_key, 
+                                                   devices[i].is_local_name, 
+                                                   devices[i].device_name, 
+                                                   devices[i].device_cb, 
+                                                   0, 
+                                                   devices[i].usr_data);
+            if (INVALID_DEVICE_HANDLE != handles[i])
+            {
+                success++;
+            }
+        }
+
+        return success;
+    }
+
+    items = (leda_register_batch_item_t *)malloc(count * sizeof(leda_register_batch_item_t));
+    if (NULL == items)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.done, NULL);
+    batch.inflight  = 0;
+    batch.handles   = handles;
+
+    /* 窗口内的请求连续发出, 有请求完成后再发下一个 */
+    for (i = 0; i < count; i++)
+    {
+        handles[i]      = INVALID_DEVICE_HANDLE;
+        items[i].batch  = &batch;
+        items[i].index  = i;
+
+        pthread_mutex_lock(&batch.lock);
+        while (batch.inflight >= window)
+        {
+            pthread_cond_wait(&batch.done, &batch.lock);
+        }
+        batch.inflight++;
+        pthread_mutex_unlock(&batch.lock);
+
+        ret = _leda_register_and_online_async(devices[i].product_key, 
+                                              devices[i].is_local_name, 
+                                              devices[i].device_name, 
+                                              devices[i].device_cb, 
+                                              0, 
+                                              devices[i].usr_data, 
+                                              INVALID_DEVICE_HANDLE, 
+                                              &_leda_register_batch_cb, 
+                                              &items[i], 
+                                              1);
+        if (LE_SUCCESS != ret)
+        {
+            log_w(LEDA_TAG_NAME, "device %s register failed, ret: %d\n", devices[i].device_name, ret);
+            pthread_mutex_lock(&batch.lock);
+            batch.inflight--;
+            pthread_mutex_unlock(&batch.lock);
+        }
+    }
+
+    pthread_mutex_lock(&batch.lock);
+    while (batch.inflight > 0)
+    {
+        pthread_cond_wait(&batch.done, &batch.lock);
+    }
+    pthread_mutex_unlock(&batch.lock);
+
+    pthread_cond_destroy(&batch.done);
+    pthread_mutex_destroy(&batch.lock);
+    free(items);
+
+    for (i = 0; i < count; i++)
+    {
+        if (INVALID_DEVICE_HANDLE != handles[i])
+        {
+            success++;
+        }
+    }
+
+    return success;
+}
+
+static void _leda_offline_async_finish(leda_async_ctx_t *ctx, int ret, const leda_retinfo_t *retinfo)
+{
+    if ((LE_SUCCESS != ret) || (LE_SUCCESS != retinfo->code))
+    {
+        log_w(LEDA_TAG_NAME, "call offline method failed, ret: %d code: %d msg: %s\n", ret, retinfo->code, retinfo->message);
+        ret = (LE_ERROR_TIMEOUT == ret) ? ret : LE_ERROR_UNKNOWN;
+    }
+
+    _leda_offline_finish(ctx->dev_handle);
+    _leda_async_deliver(ctx, ret);
+}
+
+/*
+ * 下线设备, 异步接口.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识.
+ * result_cb:   完成回调.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_offline_async(device_handle_t dev_handle, leda_device_result_callback result_cb, void *cb_data)
+{
+    int                 ret             = LE_SUCCESS;
+    leda_async_ctx_t    *ctx            = NULL;
+    leda_device_info_t  *device_info    = NULL;
+
+    if (NULL == result_cb)
+    {
+        log_w(LEDA_TAG_NAME, "result_cb is NULL\n");
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    device_info = leda_get_methodcb_by_device_handle(dev_handle);
+    if (NULL == device_info)
+    {
+        log_w(LEDA_TAG_NAME, "dev_handle:%d hasn't register\n", dev_handle);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    ctx = _leda_async_ctx_new(result_cb, NULL, cb_data);
+    if (NULL == ctx)
+    {
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    ctx->dev_handle = dev_handle;
+
+    ret = _leda_device_send_async(DMP_METHOD_DISCONNECT, device_info->cloud_id, &_leda_offline_async_finish, ctx);
+    if (LE_SUCCESS != ret)
+    {
+        _leda_async_ctx_free(ctx);
+    }
+
+    return ret;
+}
+
+static void _leda_unregister_async_finish(leda_async_ctx_t *ctx, int ret, const leda_retinfo_t *retinfo)
+{
+    if ((LE_SUCCESS != ret) || (LE_SUCCESS != retinfo->code))
+    {
+        log_w(LEDA_TAG_NAME, "call unregister method failed, ret: %d code: %d msg: %s\n", ret, retinfo->code, retinfo->message);
+        ret = (LE_ERROR_TIMEOUT == ret) ? ret : LE_ERROR_UNKNOWN;
+    }
+
+    leda_remove_methodcb(ctx->dev_handle);
+    _leda_async_deliver(ctx, ret);
+}
+
+static int _leda_unregister_send_async(leda_async_ctx_t *ctx)
+{
+    leda_device_info_t  *device_info    = NULL;
+
+    device_info = leda_get_methodcb_by_device_handle(ctx->dev_handle);
+    if (NULL == device_info)
+    {
+        log_w(LEDA_TAG_NAME, "dev_handle: %d hasn't register\n", ctx->dev_handle);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    return _leda_device_send_async(DMP_METHOD_UNREGISTER_DEVICE, device_info->cloud_id, &_leda_unregister_async_finish, ctx);
+}
+
+/* 注销前先下线, 下线结果不影响注销, 驱动退出时不再继续注销 */
+static void _leda_unregister_offline_finish(leda_async_ctx_t *ctx, int ret, const leda_retinfo_t *retinfo)
+{
+    if ((LE_SUCCESS != ret) || (LE_SUCCESS != retinfo->code))
+    {
+        log_w(LEDA_TAG_NAME, "call offline method failed, ret: %d code: %d msg: %s\n", ret, retinfo->code, retinfo->message);
+    }
+
+    _leda_offline_finish(ctx->dev_handle);
+
+    if (RUN_STATE_EXIT == leda_get_runstate())
+    {
+        _leda_async_deliver(ctx, (LE_SUCCESS != ret) ? ret : LE_ERROR_UNKNOWN);
+        return;
+    }
+
+    ret = _leda_unregister_send_async(ctx);
+    if (LE_SUCCESS != ret)
+    {
+        _leda_async_deliver(ctx, ret);
+    }
+}
+
+/*
+ * 注销设备, 异步接口, 设备在线时先下线.
+ *
+ * dev_handle:  设备在linkedge本地唯一标识.
+ * result_cb:   完成回调.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_unregister_async(device_handle_t dev_handle, leda_device_result_callback result_cb, void *cb_data)
+{
+    int                 ret             = LE_SUCCESS;
+    leda_async_ctx_t    *ctx            = NULL;
+    leda_device_info_t  *device_info    = NULL;
+
+    if (NULL == result_cb)
+    {
+        log_w(LEDA_TAG_NAME, "result_cb is NULL\n");
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    device_info = leda_get_methodcb_by_device_handle(dev_handle);
+    if (NULL == device_info)
+    {
+        log_w(LEDA_TAG_NAME, "dev_handle: %d hasn't register\n", dev_handle);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    ctx = _leda_async_ctx_new(result_cb, NULL, cb_data);
+    if (NULL == ctx)
+    {
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    ctx->dev_handle = dev_handle;
+
+    if (STATE_ONLINE == device_info->online)
+    {
+        ret = _leda_device_send_async(DMP_METHOD_DISCONNECT, device_info->cloud_id, &_leda_unregister_offline_finish, ctx);
+    }
+    else
+    {
+        ret = _leda_unregister_send_async(ctx);
+    }
+
+    if (LE_SUCCESS != ret)
+    {
+        _leda_async_ctx_free(ctx);
+    }
+
+    return ret;
+}
+
+static void _leda_config_async_finish(leda_async_ctx_t *ctx, int ret, const leda_retinfo_t *retinfo);
+
+static int _leda_config_send_async(leda_async_ctx_t *ctx, const char *header, const char *key)
+{
+    int         ret         = LE_SUCCESS;
+    char        *request_key = NULL;
+    DBusMessage *msg_call   = NULL;
+
+    request_key = malloc(strlen(key) + strlen(header) + 1);
+    if (NULL == request_key)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    snprintf(request_key, (strlen(key) + strlen(header) + 1), "%s%s", header, key);
+
+    msg_call = _leda_create_methodcall(DMP_CONFIGMANAGER_WELL_KNOW_NAME, DMP_CONFIGMANAGER_METHOD_GET);
+    if (NULL == msg_call)
+    {
+        log_w(LEDA_TAG_NAME, "create dbus method call failed\n");
+        free(request_key);
+        return LE_ERROR_UNKNOWN;
+    }
+
+    dbus_message_append_args(msg_call, DBUS_TYPE_STRING, &request_key, DBUS_TYPE_INVALID);
+    free(request_key);
+
+    ret = _leda_send_async(msg_call, DMP_CONFIGMANAGER_METHOD_GET, &_leda_config_async_finish, ctx);
+    dbus_message_unref(msg_call);
+
+    return ret;
+}
+
+static void _leda_config_async_finish(leda_async_ctx_t *ctx, int ret, const leda_retinfo_t *retinfo)
+{
+    char *key = NULL;
+
+    if ((LE_SUCCESS == ret) 
+        && (LE_SUCCESS == retinfo->code) 
+        && (NULL != retinfo->params) 
+        && (strcmp(retinfo->params, "")))
+    {
+        ctx->value = _leda_async_strdup(retinfo->params);
+        _leda_async_deliver(ctx, (NULL != ctx->value) ? LE_SUCCESS : LE_ERROR_ALLOCATING_MEM);
+        return;
+    }
+    log_w(LEDA_TAG_NAME, "call get_config method failed, ret: %d code: %d msg: %s\n", ret, retinfo->code, retinfo->message);
+
+    /* 使用驱动id获取配置失败后，再次使用驱动名称获取配置, 驱动退出时不再重试 */
+    if ((NULL != ctx->retry_key) && (RUN_STATE_EXIT != leda_get_runstate()))
+    {
+        key = ctx->retry_key;
+        ctx->retry_key = NULL;
+
+        ret = _leda_config_send_async(ctx, CONFIGMANAGER_DEVICE_HEADER, key);
+        free(key);
+        if (LE_SUCCESS == ret)
+        {
+            return;
+        }
+    }
+
+    _leda_async_deliver(ctx, (LE_ERROR_TIMEOUT == ret) ? ret : LE_ERROR_UNKNOWN);
+}
+
+/*
+ * 获取驱动配置, 异步接口, 配置内容格式见@leda_get_config.
+ *
+ * result_cb:   完成回调, 成功时value为驱动配置.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_get_config_async(leda_config_result_callback result_cb, void *cb_data)
+{
+    int                 ret     = LE_SUCCESS;
+    leda_async_ctx_t    *ctx    = NULL;
+
+    if (NULL == result_cb)
+    {
+        log_w(LEDA_TAG_NAME, "result_cb is NULL\n");
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((NULL == g_module_id) || 
+        (LE_SUCCESS != leda_string_validate_utf8(g_module_id, strlen(g_module_id))))
+    {
+        log_w(LEDA_TAG_NAME, "the driver is not deployed, check it please\n");
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    ctx = _leda_async_ctx_new(NULL, result_cb, cb_data);
+    if (NULL == ctx)
+    {
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    if (NULL != getenv("FUNCTION_NAME"))
+    {
+        ctx->retry_key = _leda_async_strdup(getenv("FUNCTION_NAME"));
+    }
+
+    ret = _leda_config_send_async(ctx, CONFIGMANAGER_DEVICE_HEADER, g_module_id);
+    if (LE_SUCCESS != ret)
+    {
+        _leda_async_ctx_free(ctx);
+    }
+
+    return ret;
+}
+
+/*
+ * 获取指定产品ProductKey对应物模型内容, 异步接口.
+ *
+ * product_key: 产品ProductKey.
+ * result_cb:   完成回调, 成功时value为物模型内容.
+ * cb_data:     完成回调私有数据.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 之后result_cb被调用且只调用一次; 失败返回错误码, result_cb不会被调用.
+ */
+int leda_get_tsl_async(const char *product_key, leda_config_result_callback result_cb, void *cb_data)
+{
+    int                 ret     = LE_SUCCESS;
+    leda_async_ctx_t    *ctx    = NULL;
+
+    if (NULL == result_cb)
+    {
+        log_w(LEDA_TAG_NAME, "result_cb is NULL\n");
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((NULL == product_key) || 
+        (LE_SUCCESS != leda_string_validate_utf8(product_key, strlen(product_key))))
+    {
+        log_w(LEDA_TAG_NAME, "product_key: %s is invalid\n", product_key);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    ctx = _leda_async_ctx_new(NULL, result_cb, cb_data);
+    if (NULL == ctx)
+    {
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    ret = _leda_config_send_async(ctx, CONFIGMANAGER_TSL_HEADER, product_key);
+    if (LE_SUCCESS != ret)
+    {
+        _leda_async_ctx_free(ctx);
+    }
+
+    return ret;
+}
+
+static void _leda_tsl_subscribe_finish(leda_async_ctx_t *ctx, int ret, const leda_retinfo_t *retinfo)
+{
+    if ((LE_SUCCESS != ret) || (LE_SUCCESS != retinfo->code))
+    {
+        log_w(LEDA_TAG_NAME, "subscribe tsl of %s failed, ret: %d code: %d\n", ctx->product_key, ret, retinfo->code);
+    }
+
+    _leda_async_deliver(ctx, ret);
+}
+
+/*
+ * 订阅产品物模型变更通知, 物模型缓存首次加载该产品时调用, 之后configmanager通知gw_TSL_<pk>变更时刷新缓存.
+ *
+ * product_key:   产品ProductKey.
+ *
+ * 非阻塞接口, 请求发出返回LE_SUCCESS, 订阅结果只记录日志; 失败返回错误码.
+ */
+static int _leda_tsl_subscribe(const char *product_key)
+{
+    int                 ret             = LE_SUCCESS;
+    char                *driver_wkn     = NULL;
+    char                *request_key    = NULL;
+    int                 type            = 1;    /* 0:拥有者 1:观察者 */
+    DBusMessage         *msg_call       = NULL;
+    leda_async_ctx_t    *ctx            = NULL;
+
+    if (NULL == g_module_id)
+    {
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    ctx = _leda_async_ctx_new(NULL, NULL, NULL);
+    if (NULL == ctx)
+    {
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    ctx->direct      = 1;
+    ctx->product_key = _leda_async_strdup(product_key);
+
+    request_key = malloc(strlen(product_key) + strlen(CONFIGMANAGER_TSL_HEADER) + 1);
+    driver_wkn  = malloc(strlen(LEDA_DRIVER_WKN) + strlen(g_module_id) + 1);
+    if ((NULL == ctx->product_key) || (NULL == request_key) || (NULL == driver_wkn))
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        ret = LE_ERROR_ALLOCATING_MEM;
+        goto END;
+    }
+    snprintf(request_key, (strlen(product_key) + strlen(CONFIGMANAGER_TSL_HEADER) + 1), "%s%s", CONFIGMANAGER_TSL_HEADER, product_key);
+    snprintf(driver_wkn, strlen(LEDA_DRIVER_WKN) + strlen(g_module_id) + 1, "%s%s", LEDA_DRIVER_WKN, g_module_id);
+
+    msg_call = _leda_create_methodcall(DMP_CONFIGMANAGER_WELL_KNOW_NAME, DMP_CONFIGMANAGER_METHOD_SUBSCRIBE);
+    if (NULL == msg_call)
+    {
+        log_w(LEDA_TAG_NAME, "create dbus method call failed\n");
+        ret = LE_ERROR_UNKNOWN;
+        goto END;
+    }
+
+    dbus_message_append_args(msg_call, DBUS_TYPE_STRING, &driver_wkn, DBUS_TYPE_STRING, &request_key, DBUS_TYPE_INT32, &type, DBUS_TYPE_INVALID);
+    ret = _leda_send_async(msg_call, DMP_CONFIGMANAGER_METHOD_SUBSCRIBE, &_leda_tsl_subscribe_finish, ctx);
+    dbus_message_unref(msg_call);
+
+END:
+    if (LE_SUCCESS != ret)
+    {
+        _leda_async_ctx_free(ctx);
+    }
+    free(request_key);
+    free(driver_wkn);
+
+    return ret;
+}
+
 #ifdef __cplusplus  /* If this is a C++ compiler, use C linkage */
 }
 #endif
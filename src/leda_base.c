@@ -22,6 +22,10 @@
 #include <string.h>
 #include <errno.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <locale.h>
+#include <pthread.h>
+#include <sched.h>
 #include <cJSON.h>
 #include <dbus/dbus.h>
 
@@ -36,144 +40,605 @@ extern "C"
 {
 #endif
 
-LIST_HEAD(leda_tsl_head);
+#define LEDA_TSL_MIN_BUCKETS    16
 
-static int _leda_get_itemtype_from_tsl_serviecs(const char* product_key, const char* service_name, const char* obj_name)
+/* 物模型缓存: 读者无锁访问已发布的快照, 写者在g_tsl_lock下复制快照并替换指针, 按epoch奇偶等待旧读者计数归零后释放 */
+static leda_tsl_cache_t * volatile  g_tsl_cache         = NULL;
+static volatile unsigned int        g_tsl_epoch         = 0;
+static volatile int                 g_tsl_readers[2]    = {0, 0};
+static volatile unsigned int        g_tsl_clock         = 0;
+static size_t                       g_tsl_max_bytes     = 0;
+static pthread_mutex_t              g_tsl_lock;
+static leda_tsl_subscribe_callback  g_tsl_subscribe_cb  = NULL;
+
+/* 已订阅物模型变更通知的product_key */
+typedef struct leda_tsl_watch
 {
-    int     ret             = LEDA_TYPE_BUTT;
-    cJSON*  object          = NULL;
-    cJSON*  services        = NULL;
-    cJSON*  service_item    = NULL;
-    cJSON*  input_item      = NULL;
-    cJSON*  sub_item        = NULL;
-    cJSON*  type_obj        = NULL;
+    struct list_head    list_node;
+    char                product_key[];
+} leda_tsl_watch_t;
 
-    int     tsl_size        = 0;
-    char*   tsl             = NULL;
+static LIST_HEAD(g_tsl_watch_head);
 
-    leda_tsl_t *tsl_node    = NULL;
-    leda_tsl_t *pos         = NULL;
-    leda_tsl_t *next        = NULL;
+static unsigned int _leda_fnv1a(unsigned int hash, const char *str)
+{
+    const unsigned char *p = NULL;
 
-    list_for_each_entry_safe(pos, next, &leda_tsl_head, list_node)
+    for (p = (const unsigned char *)str; *p; p++)
     {
-        if (!strcmp(pos->product_key, product_key))
+        hash = (hash ^ *p) * 16777619u;
+    }
+
+    return hash;
+}
+
+static unsigned int _leda_tsl_hash(const char *service_name, const char *obj_name)
+{
+    unsigned int hash = _leda_fnv1a(2166136261u, service_name);
+
+    /* 加入分隔符, 避免"ab"+"c"与"a"+"bc"冲突 */
+    hash = (hash ^ 0xff) * 16777619u;
+
+    return _leda_fnv1a(hash, obj_name);
+}
+
+static int _leda_tsl_type_from_string(const char *type)
+{
+    if (!strcmp(type, "int"))
+    {
+        return LEDA_TYPE_INT;
+    }
+    else if (!strcmp(type, "bool"))
+    {
+        return LEDA_TYPE_BOOL;
+    }
+    else if (!strcmp(type, "float"))
+    {
+        return LEDA_TYPE_FLOAT;
+    }
+    else if (!strcmp(type, "date"))
+    {
+        return LEDA_TYPE_DATE;
+    }
+    else if (!strcmp(type, "enum"))
+    {
+        return LEDA_TYPE_ENUM;
+    }
+    else if (!strcmp(type, "double"))
+    {
+        return LEDA_TYPE_DOUBLE;
+    }
+    else if (!strcmp(type, "text"))
+    {
+        return LEDA_TYPE_TEXT;
+    }
+
+    return LEDA_TYPE_BUTT;
+}
+
+static const char *_leda_tsl_identifier(cJSON *item)
+{
+    cJSON *identifier = NULL;
+
+    if (cJSON_Object != item->type)
+    {
+        return NULL;
+    }
+
+    identifier = cJSON_GetObjectItem(item, "identifier");
+    if ((NULL == identifier) || (cJSON_String != identifier->type) || (NULL == identifier->valuestring))
+    {
+        return NULL;
+    }
+
+    return identifier->valuestring;
+}
+
+static leda_tsl_item_t *_leda_tsl_lookup(const leda_tsl_t *tsl_node, const char *service_name, const char *obj_name, unsigned int hash)
+{
+    leda_tsl_item_t *item = NULL;
+
+    for (item = tsl_node->buckets[hash & tsl_node->bucket_mask]; NULL != item; item = item->next)
+    {
+        if ((hash == item->hash) && !strcmp(item->identifier, obj_name) && !strcmp(item->service, service_name))
         {
-            tsl = pos->tsl;
+            return item;
         }
     }
 
-    if (NULL == tsl)
+    return NULL;
+}
+
+/* 将物模型编译为(服务, 入参标识符)到类型的哈希索引, 桶, 条目和名字共用一次分配, json树只在编译时使用 */
+static leda_tsl_t *_leda_tsl_compile(const char *product_key, const char *tsl)
+{
+    cJSON*          object          = NULL;
+    cJSON*          services        = NULL;
+    cJSON*          service_item    = NULL;
+    cJSON*          sub_item        = NULL;
+    cJSON*          type_obj        = NULL;
+    const char*     service_name    = NULL;
+    const char*     obj_name        = NULL;
+    leda_tsl_t*     tsl_node        = NULL;
+    leda_tsl_item_t *item           = NULL;
+    char*           names           = NULL;
+    int             item_count      = 0;
+    size_t          names_size      = 0;
+    size_t          len             = 0;
+    size_t          size            = 0;
+    unsigned int    bucket_nums     = LEDA_TSL_MIN_BUCKETS;
+    unsigned int    hash            = 0;
+
+    object = cJSON_Parse(tsl);
+    if (NULL == object)
     {
-        tsl_size = leda_get_tsl_size(product_key);
-        if (tsl_size <=0)
+        log_e(LEDA_TAG_NAME, "tsl of %s parse failed\n", product_key);
+        return NULL;
+    }
+
+    services = cJSON_GetObjectItem(object, "services");
+
+    /* 第一遍统计索引大小 */
+    cJSON_ArrayForEach(service_item, services)
+    {
+        service_name = _leda_tsl_identifier(service_item);
+        if (NULL == service_name)
         {
-            goto END;
+            continue;
         }
 
-        tsl = (char*)malloc(tsl_size);
-        if (NULL == tsl)
+        cJSON_ArrayForEach(sub_item, cJSON_GetObjectItem(service_item, "inputData"))
+        {
+            obj_name = _leda_tsl_identifier(sub_item);
+            if (NULL == obj_name)
+            {
+                continue;
+            }
+
+            item_count++;
+            names_size += strlen(service_name) + strlen(obj_name) + 2;
+        }
+    }
+
+    while (bucket_nums < (unsigned int)item_count * 2)
+    {
+        bucket_nums <<= 1;
+    }
+
+    len = strlen(product_key) + 1;
+    size = sizeof(leda_tsl_t) 
+           + sizeof(leda_tsl_item_t *) * bucket_nums 
+           + sizeof(leda_tsl_item_t) * item_count 
+           + names_size + len;
+    tsl_node = (leda_tsl_t *)malloc(size);
+    if (NULL == tsl_node)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        cJSON_Delete(object);
+        return NULL;
+    }
+
+    memset(tsl_node, 0, sizeof(leda_tsl_t));
+    tsl_node->pk_hash       = _leda_fnv1a(2166136261u, product_key);
+    tsl_node->size          = size;
+    tsl_node->used          = g_tsl_clock;
+    tsl_node->buckets       = (leda_tsl_item_t **)(tsl_node + 1);
+    tsl_node->bucket_mask   = bucket_nums - 1;
+    tsl_node->items         = (leda_tsl_item_t *)(tsl_node->buckets + bucket_nums);
+    names                   = (char *)(tsl_node->items + item_count);
+    memset(tsl_node->buckets, 0, sizeof(leda_tsl_item_t *) * bucket_nums);
+
+    tsl_node->product_key = names;
+    memcpy(names, product_key, len);
+    names += len;
+
+    /* 第二遍填充索引, 标识符重复时以首次定义为准 */
+    cJSON_ArrayForEach(service_item, services)
+    {
+        service_name = _leda_tsl_identifier(service_item);
+        if (NULL == service_name)
         {
-            goto END;
+            continue;
         }
 
-        if (LE_SUCCESS != leda_get_tsl(product_key, tsl, tsl_size))
+        cJSON_ArrayForEach(sub_item, cJSON_GetObjectItem(service_item, "inputData"))
         {
-            free(tsl);
-            goto END;
+            obj_name = _leda_tsl_identifier(sub_item);
+            if (NULL == obj_name)
+            {
+                continue;
+            }
+
+            hash = _leda_tsl_hash(service_name, obj_name);
+            if (NULL != _leda_tsl_lookup(tsl_node, service_name, obj_name, hash))
+            {
+                continue;
+            }
+
+            item = &tsl_node->items[tsl_node->item_count++];
+            item->hash = hash;
+            item->type = LEDA_TYPE_BUTT;
+
+            type_obj = cJSON_GetObjectItem(cJSON_GetObjectItem(sub_item, "dataType"), "type");
+            if ((NULL != type_obj) && (cJSON_String == type_obj->type) && (NULL != type_obj->valuestring))
+            {
+                item->type = _leda_tsl_type_from_string(type_obj->valuestring);
+            }
+
+            len = strlen(service_name) + 1;
+            memcpy(names, service_name, len);
+            item->service = names;
+            names += len;
+
+            len = strlen(obj_name) + 1;
+            memcpy(names, obj_name, len);
+            item->identifier = names;
+            names += len;
+
+            item->next = tsl_node->buckets[hash & tsl_node->bucket_mask];
+            tsl_node->buckets[hash & tsl_node->bucket_mask] = item;
         }
+    }
+
+    cJSON_Delete(object);
 
-        tsl_node = (leda_tsl_t*)malloc(sizeof(leda_tsl_t));
-        memset(tsl_node, 0, sizeof(leda_tsl_t));
+    return tsl_node;
+}
 
-        tsl_node->product_key = (char*)malloc(strlen(product_key) + 1);
-        if (NULL == tsl_node->product_key)
+static int _leda_tsl_read_lock(void)
+{
+    int idx = 0;
+
+    for (;;)
+    {
+        idx = g_tsl_epoch & 1;
+        (void)__sync_add_and_fetch(&g_tsl_readers[idx], 1);
+
+        /* 登记前epoch可能已翻转, 此时写者不会等待本读者, 需重新登记 */
+        if (idx == (int)(g_tsl_epoch & 1))
         {
-            free(tsl);
-            free(tsl_node);
-            goto END;
+            return idx;
         }
+        (void)__sync_sub_and_fetch(&g_tsl_readers[idx], 1);
+    }
+}
 
-        memcpy(tsl_node->product_key, product_key, (strlen(product_key) + 1));
-        tsl_node->tsl = tsl;
+static void _leda_tsl_read_unlock(int idx)
+{
+    (void)__sync_sub_and_fetch(&g_tsl_readers[idx], 1);
+}
 
-        list_add(&tsl_node->list_node, &leda_tsl_head);
+/* 发布新快照后调用, 调用者需持有g_tsl_lock */
+static void _leda_tsl_synchronize(void)
+{
+    int idx = 0;
+
+    __sync_synchronize();
+    idx = g_tsl_epoch & 1;
+    (void)__sync_add_and_fetch(&g_tsl_epoch, 1);
+
+    while (0 != __sync_fetch_and_add(&g_tsl_readers[idx], 0))
+    {
+        sched_yield();
     }
+}
 
-    object = cJSON_Parse(tsl);
-    if (NULL == object)
+static int _leda_tsl_find(const leda_tsl_cache_t *cache, const char *product_key, unsigned int pk_hash)
+{
+    int i = 0;
+
+    if (NULL == cache)
     {
-        goto END;
+        return -1;
     }
 
-    services = cJSON_GetObjectItem(object, "services");
-    if (NULL == services)
+    for (i = 0; i < cache->count; i++)
     {
-        goto END;
+        if ((pk_hash == cache->nodes[i]->pk_hash) && !strcmp(cache->nodes[i]->product_key, product_key))
+        {
+            return i;
+        }
     }
 
-    cJSON_ArrayForEach(service_item, services)
+    return -1;
+}
+
+/* 发布替换第idx项后的快照副本(idx<0追加, tsl_node为NULL删除), 超出g_tsl_max_bytes时淘汰最久未用项; 调用者需持有g_tsl_lock */
+static int _leda_tsl_publish(int idx, leda_tsl_t *tsl_node)
+{
+    leda_tsl_cache_t    *old_cache  = g_tsl_cache;
+    leda_tsl_cache_t    *new_cache  = NULL;
+    leda_tsl_t          **retired   = NULL;
+    int                 old_count   = (NULL == old_cache) ? 0 : old_cache->count;
+    int                 retired_num = 0;
+    int                 victim      = 0;
+    int                 i           = 0;
+
+    new_cache = (leda_tsl_cache_t *)malloc(sizeof(leda_tsl_cache_t) + sizeof(leda_tsl_t *) * (old_count + 1));
+    retired = (leda_tsl_t **)malloc(sizeof(leda_tsl_t *) * (old_count + 1));
+    if ((NULL == new_cache) || (NULL == retired))
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        free(new_cache);
+        free(retired);
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    new_cache->count = 0;
+    new_cache->size  = 0;
+    for (i = 0; i < old_count; i++)
     {
-        if (cJSON_Object == service_item->type)
+        if (i == idx)
         {
-            if (strcmp(service_name, cJSON_GetObjectItem(service_item, "identifier")->valuestring))
+            retired[retired_num++] = old_cache->nodes[i];
+            continue;
+        }
+        new_cache->nodes[new_cache->count++] = old_cache->nodes[i];
+        new_cache->size += old_cache->nodes[i]->size;
+    }
+
+    if (NULL != tsl_node)
+    {
+        new_cache->nodes[new_cache->count++] = tsl_node;
+        new_cache->size += tsl_node->size;
+    }
+
+    /* 新加入的节点在末尾且不被淘汰, 单个超限的物模型仍可缓存 */
+    while ((g_tsl_max_bytes > 0) && (new_cache->size > g_tsl_max_bytes) && (new_cache->count > 1))
+    {
+        victim = 0;
+        for (i = 1; i < new_cache->count - 1; i++)
+        {
+            if ((int)(new_cache->nodes[i]->used - new_cache->nodes[victim]->used) < 0)
             {
-                continue;
+                victim = i;
             }
+        }
 
-            input_item = cJSON_GetObjectItem(service_item, "inputData");
-            cJSON_ArrayForEach(sub_item, input_item)
-            {
-                if (strcmp(obj_name, cJSON_GetObjectItem(sub_item, "identifier")->valuestring)) 
-                {
-                    continue;
-                }
+        log_d(LEDA_TAG_NAME, "tsl of %s evicted\n", new_cache->nodes[victim]->product_key);
+        retired[retired_num++] = new_cache->nodes[victim];
+        new_cache->size -= new_cache->nodes[victim]->size;
+        memmove(&new_cache->nodes[victim], &new_cache->nodes[victim + 1], sizeof(leda_tsl_t *) * (new_cache->count - victim - 1));
+        new_cache->count--;
+    }
 
-                type_obj = cJSON_GetObjectItem(cJSON_GetObjectItem(sub_item, "dataType"), "type");
-                if (!strcmp(type_obj->valuestring, "int"))
-                {
-                    ret = LEDA_TYPE_INT;
-                }
-                else if (!strcmp(type_obj->valuestring, "bool"))
-                {
-                    ret = LEDA_TYPE_BOOL;
-                }
-                else if (!strcmp(type_obj->valuestring, "float"))
-                {
-                    ret = LEDA_TYPE_FLOAT;
-                }
-                else if (!strcmp(type_obj->valuestring, "date"))
-                {
-                    ret = LEDA_TYPE_DATE;
-                }
-                else if (!strcmp(type_obj->valuestring, "enum"))
-                {
-                    ret = LEDA_TYPE_ENUM;
-                }
-                else if (!strcmp(type_obj->valuestring, "double"))
-                {
-                    ret = LEDA_TYPE_DOUBLE;
-                }
-                else if (!strcmp(type_obj->valuestring, "text"))
-                {
-                    ret = LEDA_TYPE_TEXT;
-                }
-                
-                goto END;
-            }
+    /* 弱内存序cpu上快照内容需先于指针可见 */
+    __sync_synchronize();
+    g_tsl_cache = new_cache;
+    _leda_tsl_synchronize();
+
+    for (i = 0; i < retired_num; i++)
+    {
+        free(retired[i]);
+    }
+    free(retired);
+    free(old_cache);
+
+    return LE_SUCCESS;
+}
+
+/* product_key未订阅时标记为已订阅并返回1, 否则返回0 */
+static int _leda_tsl_watch(const char *product_key)
+{
+    leda_tsl_watch_t *pos = NULL;
+
+    list_for_each_entry(pos, &g_tsl_watch_head, list_node)
+    {
+        if (!strcmp(pos->product_key, product_key))
+        {
+            return 0;
         }
     }
 
-END:
+    pos = (leda_tsl_watch_t *)malloc(sizeof(leda_tsl_watch_t) + strlen(product_key) + 1);
+    if (NULL == pos)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return 0;
+    }
+    strcpy(pos->product_key, product_key);
+    list_add(&pos->list_node, &g_tsl_watch_head);
+
+    return 1;
+}
 
-    if (NULL != object)
+/* 获取并编译未缓存的物模型, 返回的节点发布前归调用者所有 */
+static leda_tsl_t *_leda_tsl_load(const char *product_key)
+{
+    int         tsl_size    = 0;
+    char        *tsl        = NULL;
+    leda_tsl_t  *tsl_node   = NULL;
+
+    tsl_size = leda_get_tsl_size(product_key);
+    if (tsl_size <= 0)
     {
-        cJSON_Delete(object);
+        return NULL;
+    }
+
+    tsl = (char*)malloc(tsl_size);
+    if (NULL == tsl)
+    {
+        return NULL;
+    }
+
+    if (LE_SUCCESS == leda_get_tsl(product_key, tsl, tsl_size))
+    {
+        tsl_node = _leda_tsl_compile(product_key, tsl);
     }
+    free(tsl);
+
+    return tsl_node;
+}
+
+static void _leda_tsl_insert(const char *product_key, leda_tsl_t *tsl_node)
+{
+    int subscribe = 0;
+
+    pthread_mutex_lock(&g_tsl_lock);
+    (void)__sync_add_and_fetch(&g_tsl_clock, 1);
+
+    /* 期间其他线程可能已加载同一产品, 保留已缓存的节点 */
+    if ((_leda_tsl_find(g_tsl_cache, tsl_node->product_key, tsl_node->pk_hash) >= 0)
+        || (LE_SUCCESS != _leda_tsl_publish(-1, tsl_node)))
+    {
+        free(tsl_node);
+        pthread_mutex_unlock(&g_tsl_lock);
+        return;
+    }
+
+    subscribe = _leda_tsl_watch(tsl_node->product_key);
+    pthread_mutex_unlock(&g_tsl_lock);
+
+    if (subscribe && (NULL != g_tsl_subscribe_cb))
+    {
+        (void)g_tsl_subscribe_cb(product_key);
+    }
+}
+
+static int _leda_get_itemtype_from_tsl_serviecs(const char* product_key, const char* service_name, const char* obj_name)
+{
+    int                 ret         = LEDA_TYPE_BUTT;
+    int                 found       = 0;
+    int                 idx         = 0;
+    int                 rd          = 0;
+    unsigned int        pk_hash     = _leda_fnv1a(2166136261u, product_key);
+    unsigned int        hash        = _leda_tsl_hash(service_name, obj_name);
+    unsigned int        clock       = 0;
+    leda_tsl_cache_t    *cache      = NULL;
+    leda_tsl_t          *tsl_node   = NULL;
+    leda_tsl_item_t     *item       = NULL;
+
+    rd = _leda_tsl_read_lock();
+    cache = g_tsl_cache;
+    idx = _leda_tsl_find(cache, product_key, pk_hash);
+    if (idx >= 0)
+    {
+        found = 1;
+        tsl_node = cache->nodes[idx];
+
+        /* 值变化时才写入, 避免频繁查找反复写脏缓存行 */
+        clock = g_tsl_clock;
+        if (tsl_node->used != clock)
+        {
+            tsl_node->used = clock;
+        }
+
+        item = _leda_tsl_lookup(tsl_node, service_name, obj_name, hash);
+        if (NULL != item)
+        {
+            ret = item->type;
+        }
+    }
+    _leda_tsl_read_unlock(rd);
+
+    if (found)
+    {
+        return ret;
+    }
+
+    tsl_node = _leda_tsl_load(product_key);
+    if (NULL == tsl_node)
+    {
+        return LEDA_TYPE_BUTT;
+    }
+
+    item = _leda_tsl_lookup(tsl_node, service_name, obj_name, hash);
+    if (NULL != item)
+    {
+        ret = item->type;
+    }
+
+    _leda_tsl_insert(product_key, tsl_node);
 
     return ret;
 }
 
+int leda_tsl_cache_init(int max_bytes, leda_tsl_subscribe_callback subscribe_cb)
+{
+    pthread_mutex_init(&g_tsl_lock, NULL);
+    g_tsl_max_bytes    = (max_bytes > 0) ? (size_t)max_bytes : 0;
+    g_tsl_subscribe_cb = subscribe_cb;
+
+    return LE_SUCCESS;
+}
+
+/* 产品物模型是否已缓存, 只读查询不加载, 不会阻塞 */
+int leda_tsl_cache_contains(const char *product_key)
+{
+    int rd  = 0;
+    int idx = 0;
+
+    rd = _leda_tsl_read_lock();
+    idx = _leda_tsl_find(g_tsl_cache, product_key, _leda_fnv1a(2166136261u, product_key));
+    _leda_tsl_read_unlock(rd);
+
+    return (idx >= 0) ? 1 : 0;
+}
+
+/* 用通知内容替换已缓存的物模型, 编译失败时删除以便下次请求重新获取, 未缓存的产品不处理 */
+int leda_tsl_cache_update(const char *product_key, const char *tsl)
+{
+    int         idx         = 0;
+    leda_tsl_t  *tsl_node   = NULL;
+
+    if (NULL == product_key)
+    {
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if ((NULL != tsl) && ('\0' != tsl[0]))
+    {
+        tsl_node = _leda_tsl_compile(product_key, tsl);
+    }
+
+    pthread_mutex_lock(&g_tsl_lock);
+    (void)__sync_add_and_fetch(&g_tsl_clock, 1);
+    idx = _leda_tsl_find(g_tsl_cache, product_key, _leda_fnv1a(2166136261u, product_key));
+    if (idx < 0)
+    {
+        pthread_mutex_unlock(&g_tsl_lock);
+        free(tsl_node);
+        return LE_SUCCESS;
+    }
+
+    log_i(LEDA_TAG_NAME, "tsl of %s changed, %s\n", product_key, (NULL != tsl_node) ? "refreshed" : "invalidated");
+    if (LE_SUCCESS != _leda_tsl_publish(idx, tsl_node))
+    {
+        pthread_mutex_unlock(&g_tsl_lock);
+        free(tsl_node);
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    pthread_mutex_unlock(&g_tsl_lock);
+
+    return LE_SUCCESS;
+}
+
+/* 驱动退出且线程池销毁后调用, 此时已无读者 */
+void leda_tsl_cache_destroy(void)
+{
+    leda_tsl_watch_t    *pos    = NULL;
+    leda_tsl_watch_t    *next   = NULL;
+    int                 i       = 0;
+
+    if (NULL != g_tsl_cache)
+    {
+        for (i = 0; i < g_tsl_cache->count; i++)
+        {
+            free(g_tsl_cache->nodes[i]);
+        }
+        free(g_tsl_cache);
+        g_tsl_cache = NULL;
+    }
+
+    list_for_each_entry_safe(pos, next, &g_tsl_watch_head, list_node)
+    {
+        list_del(&pos->list_node);
+        free(pos);
+    }
+
+    pthread_mutex_destroy(&g_tsl_lock);
+}
+
 #define UNICODE_VALID(Char)                         \
     ((Char) < 0x110000 &&                           \
     (((Char) & 0xFFFFF800) != 0xD800))
@@ -890,59 +1355,311 @@ char *leda_params_parse(const char *params, char *key)
     return value;
 }
 
-char *leda_transform_data_struct_to_string(const leda_device_data_t data[], int count)
+/* 确保还能写入n字节及结束符 */
+static int _leda_json_reserve(leda_json_writer_t *writer, size_t n)
 {
-    int     i       = 0;
-    char*   output  = NULL;
-    cJSON*  object  = NULL;
-    
-    object = cJSON_CreateObject();
-    if (NULL == object)
+    size_t  size    = 0;
+    char    *buf    = NULL;
+
+    if (writer->error)
+    {
+        return 0;
+    }
+
+    if (writer->size - writer->len > n)
+    {
+        return 1;
+    }
+
+    size = (writer->size > 0) ? writer->size : 256;
+    while (size - writer->len <= n)
+    {
+        size <<= 1;
+    }
+
+    buf = writer->dynamic ? (char *)realloc(writer->buf, size) : (char *)malloc(size);
+    if (NULL == buf)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        writer->error = 1;
+        return 0;
+    }
+
+    if (!writer->dynamic && (writer->len > 0))
+    {
+        memcpy(buf, writer->buf, writer->len + 1);
+    }
+    writer->buf     = buf;
+    writer->size    = size;
+    writer->dynamic = 1;
+
+    return 1;
+}
+
+void leda_json_writer_init(leda_json_writer_t *writer, char *buf, size_t size)
+{
+    writer->buf     = buf;
+    writer->size    = (NULL != buf) ? size : 0;
+    writer->len     = 0;
+    writer->dynamic = 0;
+    writer->error   = 0;
+
+    if (writer->size > 0)
+    {
+        writer->buf[0] = '\0';
+    }
+}
+
+void leda_json_writer_free(leda_json_writer_t *writer)
+{
+    if (writer->dynamic)
+    {
+        free(writer->buf);
+    }
+
+    writer->buf     = NULL;
+    writer->size    = 0;
+    writer->len     = 0;
+    writer->dynamic = 0;
+}
+
+void leda_json_write_raw(leda_json_writer_t *writer, const char *str, size_t len)
+{
+    if (!_leda_json_reserve(writer, len))
+    {
+        return;
+    }
+
+    memcpy(writer->buf + writer->len, str, len);
+    writer->len += len;
+    writer->buf[writer->len] = '\0';
+}
+
+void leda_json_write_fmt(leda_json_writer_t *writer, const char *fmt, ...)
+{
+    va_list args;
+    int     len     = 0;
+
+    if (!_leda_json_reserve(writer, 0))
+    {
+        return;
+    }
+
+    va_start(args, fmt);
+    len = vsnprintf(writer->buf + writer->len, writer->size - writer->len, fmt, args);
+    va_end(args);
+    if (len < 0)
+    {
+        writer->error = 1;
+        return;
+    }
+
+    if ((size_t)len >= writer->size - writer->len)
+    {
+        if (!_leda_json_reserve(writer, (size_t)len))
+        {
+            return;
+        }
+
+        va_start(args, fmt);
+        vsnprintf(writer->buf + writer->len, writer->size - writer->len, fmt, args);
+        va_end(args);
+    }
+    writer->len += len;
+}
+
+/* 与cJSON相同的转义规则: 转义引号, 反斜杠和控制字符, 其余字符原样输出 */
+static void _leda_json_write_string(leda_json_writer_t *writer, const char *str)
+{
+    const unsigned char *p      = NULL;
+    const unsigned char *run    = NULL;
+    char                esc[8];
+
+    leda_json_write_raw(writer, "\"", 1);
+    for (p = run = (const unsigned char *)str; *p; p++)
     {
-        goto END;
+        if ((*p > 31) && (*p != '\"') && (*p != '\\'))
+        {
+            continue;
+        }
+
+        leda_json_write_raw(writer, (const char *)run, p - run);
+        run = p + 1;
+        switch (*p)
+        {
+        case '\"': leda_json_write_raw(writer, "\\\"", 2); break;
+        case '\\': leda_json_write_raw(writer, "\\\\", 2); break;
+        case '\b': leda_json_write_raw(writer, "\\b", 2); break;
+        case '\f': leda_json_write_raw(writer, "\\f", 2); break;
+        case '\n': leda_json_write_raw(writer, "\\n", 2); break;
+        case '\r': leda_json_write_raw(writer, "\\r", 2); break;
+        case '\t': leda_json_write_raw(writer, "\\t", 2); break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", *p);
+            leda_json_write_raw(writer, esc, 6);
+            break;
+        }
     }
+    leda_json_write_raw(writer, (const char *)run, p - run);
+    leda_json_write_raw(writer, "\"", 1);
+}
 
+/* 与cJSON相同的数字格式: %1.15g不能还原时用%1.17g, nan和inf输出null */
+static void _leda_json_write_number(leda_json_writer_t *writer, double d)
+{
+    char    number[32];
+    char    decimal_point   = localeconv()->decimal_point[0];
+    double  test            = 0;
+    int     len             = 0;
+    int     i               = 0;
+
+    if ((d * 0) != 0)
+    {
+        leda_json_write_raw(writer, "null", 4);
+        return;
+    }
+
+    len = snprintf(number, sizeof(number), "%1.15g", d);
+    if ((sscanf(number, "%lg", &test) != 1) || (test != d))
+    {
+        len = snprintf(number, sizeof(number), "%1.17g", d);
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        if (number[i] == decimal_point)
+        {
+            number[i] = '.';
+        }
+    }
+
+    leda_json_write_raw(writer, number, len);
+}
+
+/* 结构体和数组值经cJSON校验并压缩后直接输出到缓冲区 */
+static int _leda_json_write_parsed(leda_json_writer_t *writer, const char *value)
+{
+    cJSON   *item   = NULL;
+    size_t  need    = 0;
+
+    item = cJSON_Parse(value);
+    if (NULL == item)
+    {
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    need = strlen(value) + 64;
+    while (_leda_json_reserve(writer, need))
+    {
+        if (cJSON_PrintPreallocated(item, writer->buf + writer->len, (int)(writer->size - writer->len), false))
+        {
+            writer->len += strlen(writer->buf + writer->len);
+            break;
+        }
+        writer->buf[writer->len] = '\0';
+        need <<= 1;
+    }
+    cJSON_Delete(item);
+
+    return LE_SUCCESS;
+}
+
+/* 将data[]写为{"key":value,...}, time_ms>=0时写为{"key":{"time":time_ms,"value":value},...}; 非法结构体值跳过, 未知类型整体失败 */
+int leda_json_write_data(leda_json_writer_t *writer, const leda_device_data_t data[], int count, long long time_ms)
+{
+    size_t  start   = writer->len;
+    size_t  mark    = 0;
+    int     first   = 1;
+    int     i       = 0;
+
+    leda_json_write_raw(writer, "{", 1);
     for (i = 0; i < count; i++)
     {
+        mark = writer->len;
+        if (!first)
+        {
+            leda_json_write_raw(writer, ",", 1);
+        }
+        _leda_json_write_string(writer, data[i].key);
+        leda_json_write_raw(writer, ":", 1);
+        if (time_ms >= 0)
+        {
+            leda_json_write_fmt(writer, "{\"time\":%lld,\"value\":", time_ms);
+        }
+
         if ((data[i].type == LEDA_TYPE_TEXT)
             || (data[i].type == LEDA_TYPE_DATE))
         {
-            cJSON_AddStringToObject(object, data[i].key, data[i].value);
+            _leda_json_write_string(writer, data[i].value);
         }
         else if (data[i].type == LEDA_TYPE_FLOAT)
         {
-            cJSON_AddNumberToObject(object, data[i].key, strtof(data[i].value, NULL));
+            _leda_json_write_number(writer, strtof(data[i].value, NULL));
         }
         else if (data[i].type == LEDA_TYPE_DOUBLE)
         {
-            cJSON_AddNumberToObject(object, data[i].key, strtod(data[i].value, NULL));
+            _leda_json_write_number(writer, strtod(data[i].value, NULL));
         }
         else if ((data[i].type == LEDA_TYPE_INT)
-                 ||(data[i].type == LEDA_TYPE_BOOL)
+                 || (data[i].type == LEDA_TYPE_BOOL)
                  || (data[i].type == LEDA_TYPE_ENUM))
         {
-            cJSON_AddNumberToObject(object, data[i].key, atoi(data[i].value));
+            leda_json_write_fmt(writer, "%d", atoi(data[i].value));
         }
-        else if((data[i].type == LEDA_TYPE_STRUCT)||(data[i].type == LEDA_TYPE_ARRAY))
+        else if ((data[i].type == LEDA_TYPE_STRUCT) || (data[i].type == LEDA_TYPE_ARRAY))
         {
-            cJSON_AddItemToObject(object, data[i].key, cJSON_Parse(data[i].value));
+            if (LE_SUCCESS != _leda_json_write_parsed(writer, data[i].value))
+            {
+                writer->len = mark;
+                if (!writer->error)
+                {
+                    writer->buf[mark] = '\0';
+                }
+                continue;
+            }
         }
         else
         {
-            goto END;
+            writer->len = start;
+            if (!writer->error && (writer->size > 0))
+            {
+                writer->buf[start] = '\0';
+            }
+            return LE_ERROR_INVAILD_PARAM;
+        }
+
+        if (time_ms >= 0)
+        {
+            leda_json_write_raw(writer, "}", 1);
         }
+        first = 0;
     }
+    leda_json_write_raw(writer, "}", 1);
 
-    output = cJSON_PrintUnformatted(object);
+    return writer->error ? LE_ERROR_ALLOCATING_MEM : LE_SUCCESS;
+}
+
+char *leda_transform_data_struct_to_string(const leda_device_data_t data[], int count)
+{
+    int                 i       = 0;
+    size_t              size    = 2;
+    leda_json_writer_t  writer;
 
-END:
+    /* 按无需转义的常见情况一次分配足够空间 */
+    for (i = 0; i < count; i++)
+    {
+        size += strlen(data[i].key) + strlen(data[i].value) + 8;
+    }
 
-    if (NULL != object)
+    leda_json_writer_init(&writer, NULL, 0);
+    if (!_leda_json_reserve(&writer, size)
+        || (LE_SUCCESS != leda_json_write_data(&writer, data, count, -1)))
     {
-        cJSON_Delete(object);
+        leda_json_writer_free(&writer);
+        return NULL;
     }
 
-    return output;
+    return writer.buf;
 }
 
 int leda_transform_data_json_to_struct(const char* product_key, 
@@ -89,14 +89,65 @@ extern "C"
 #define LEDA_DEVICE_CONFIG_LIST             "deviceList"
 #define LEDA_DEVICE_CONFIG_CUSTOM           "custom"
 
-/* 物模型信息链表 */
+/* 
+* 消息成员名编号
+* 注: 方法名(member)和设备服务名(service_name)在消息入口处查表转换一次, 随请求传递, 后续按编号分支
+*/
+typedef enum
+{
+    LEDA_MEMBER_UNKNOWN = 0,                /* 未知方法, 对服务名而言为自定义服务 */
+    LEDA_MEMBER_INTROSPECT,                 /* DMP_METHOD_INTROSPECT */
+    LEDA_MEMBER_CALL_SERVICES,              /* DMP_METHOD_CALLMETHOD */
+    LEDA_MEMBER_GET_PROPERTIES,             /* LEDA_DEV_METHOD_GET_PROPERTIES */
+    LEDA_MEMBER_SET_PROPERTIES,             /* LEDA_DEV_METHOD_SET_PROPERTIES */
+    LEDA_MEMBER_GET_DEV_LIST,               /* LEDA_DRV_METHOD_GET_DEV_LIST */
+    LEDA_MEMBER_CONFIG_NOTIFY,              /* DMP_CONFIGMANAGER_METHOD_NOTIFY */
+    LEDA_MEMBER_RESULT_NOTIFY,              /* DMP_METHOD_RESULT_NOTIFY */
+
+    LEDA_MEMBER_BUTT
+} leda_member_e;
+
+/* 物模型参数索引项 */
+typedef struct leda_tsl_item
+{
+    struct leda_tsl_item *next;     /* 哈希桶链表 */
+    unsigned int hash;              /* 服务名与参数名的哈希值 */
+    int type;                       /* 参数类型, 参考leda_data_type_e, 未知类型为LEDA_TYPE_BUTT */
+    const char *service;            /* 服务标识符 */
+    const char *identifier;         /* 参数标识符 */
+}leda_tsl_item_t;
+
+/*
+* 物模型索引
+* 注: 物模型获取后只解析一次, 编译为"服务名+参数名"到参数类型的哈希索引, 不再保存原始文本;
+*     节点, 哈希桶, 索引项及字符串在同一块内存中, 释放时只需free节点; 编译完成后只读
+*/
 typedef struct leda_tsl
 {
-    struct list_head list_node;
-    char *product_key;  /* 产品pk */
-    char *tsl;          /* 物模型 */
+    char *product_key;              /* 产品pk */
+    unsigned int pk_hash;           /* 产品pk的哈希值 */
+    size_t size;                    /* 节点占用内存(字节) */
+    volatile unsigned int used;     /* 最近使用时的缓存时钟, 用于淘汰最久未使用的物模型 */
+    leda_tsl_item_t **buckets;      /* 参数索引哈希桶 */
+    unsigned int bucket_mask;       /* 哈希桶数目减1, 桶数目为2的幂 */
+    leda_tsl_item_t *items;         /* 参数索引项 */
+    int item_count;                 /* 参数索引项数目 */
 }leda_tsl_t;
 
+/*
+* 物模型缓存快照
+* 注: 快照发布后不再修改, 读者不加锁; 更新时复制出新快照替换, 等待旧快照的读者退出后再释放
+*/
+typedef struct leda_tsl_cache
+{
+    int count;                      /* 缓存的产品数目 */
+    size_t size;                    /* 所有物模型索引占用内存(字节) */
+    leda_tsl_t *nodes[];            /* 各产品物模型索引 */
+}leda_tsl_cache_t;
+
+/* 物模型首次缓存时回调, 用于订阅该产品的物模型变更通知 */
+typedef int (*leda_tsl_subscribe_callback)(const char *product_key);
+
 /* 方法调用返回数据 */
 typedef struct leda_retinfo
 {
@@ -119,6 +170,33 @@ void leda_retinfo_free(leda_retinfo_t *retinfo);
 char *leda_mothedret_create(int code, const leda_device_data_t data[], int count);
 char *leda_params_parse(const char *params, char *key);
 
+/*
+* JSON流式写入器
+* 注: 直接向调用者提供的缓冲区输出, 不足时转为动态分配并按倍数扩容, 输出始终以'\0'结尾;
+*     内存不足时置位error, 之后的写入被忽略
+*/
+#define LEDA_JSON_STACK_BUFF_SIZE   4096    /* 上报编码使用的栈缓冲大小, 超出时写入器转为动态分配 */
+
+typedef struct leda_json_writer
+{
+    char *buf;                      /* 输出缓冲 */
+    size_t size;                    /* 缓冲大小 */
+    size_t len;                     /* 已写入长度, 不含结尾'\0' */
+    int dynamic;                    /* 缓冲是否为动态分配, 由leda_json_writer_free释放 */
+    int error;                      /* 是否发生内存不足 */
+}leda_json_writer_t;
+
+void leda_json_writer_init(leda_json_writer_t *writer, char *buf, size_t size);
+void leda_json_writer_free(leda_json_writer_t *writer);
+void leda_json_write_raw(leda_json_writer_t *writer, const char *str, size_t len);
+void leda_json_write_fmt(leda_json_writer_t *writer, const char *fmt, ...);
+int  leda_json_write_data(leda_json_writer_t *writer, const leda_device_data_t data[], int count, long long time_ms);
+
+int  leda_tsl_cache_init(int max_bytes, leda_tsl_subscribe_callback subscribe_cb);
+int  leda_tsl_cache_contains(const char *product_key);
+int  leda_tsl_cache_update(const char *product_key, const char *tsl);
+void leda_tsl_cache_destroy(void);
+
 char *leda_transform_data_struct_to_string(const leda_device_data_t data[], int count);
 int  leda_transform_data_json_to_struct(const char* product_key,
                                         const char* service_name, 
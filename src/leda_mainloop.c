@@ -0,0 +1,599 @@
+/*
+ * Copyright (c) 2014-2019 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <dbus/dbus.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "log.h"
+#include "le_error.h"
+#include "leda.h"
+#include "linux-list.h"
+#include "leda_mainloop.h"
+
+#if defined(__cplusplus) /* If this is a C++ compiler, use C linkage */
+extern "C"
+{
+#endif
+
+#define MAINLOOP_EVENT_NUM      16          /* 单次epoll_wait最多处理的事件数 */
+#define MAINLOOP_HANDLE_NUM     8           /* 单个fd或单次超时最多处理的watch/timeout数 */
+
+/* 处理中的watch/timeout在libdbus删除时不能立即释放, 删除方等待处理结束, 或在处理线程自身中删除时交给处理线程释放 */
+typedef struct leda_mainloop_pin
+{
+    int                 pinned;             /* 已被处理线程取出尚未处理完的次数 */
+    int                 dead;               /* 已被libdbus删除, 不能再调用handle */
+    int                 handoff;            /* 在处理线程中删除, 由处理线程释放 */
+    pthread_t           owner;              /* 处理线程 */
+} leda_mainloop_pin_t;
+
+typedef struct leda_mainloop_watch
+{
+    struct list_head    list_node;
+    DBusWatch           *watch;
+    leda_mainloop_pin_t pin;
+} leda_mainloop_watch_t;
+
+typedef struct leda_mainloop_timeout
+{
+    struct list_head    list_node;
+    DBusTimeout         *timeout;
+    uint64_t            deadline;           /* 超时时间(单调时钟毫秒), 未使能时为0 */
+    leda_mainloop_pin_t pin;
+} leda_mainloop_timeout_t;
+
+/* 处理线程取出watch/timeout; 调用者需持有loop->lock */
+static void _leda_mainloop_pin(leda_mainloop_pin_t *pin)
+{
+    pin->pinned++;
+    pin->owner = pthread_self();
+}
+
+/* 处理结束, 返回1表示删除已交给处理线程, 调用者在释放锁后释放节点; 调用者需持有loop->lock */
+static int _leda_mainloop_unpin(leda_mainloop_t *loop, leda_mainloop_pin_t *pin)
+{
+    if (0 != --pin->pinned)
+    {
+        return 0;
+    }
+
+    if (pin->handoff)
+    {
+        return 1;
+    }
+
+    if (pin->dead)
+    {
+        pthread_cond_broadcast(&loop->unpinned);
+    }
+
+    return 0;
+}
+
+/* libdbus删除watch/timeout, 返回1表示调用者可释放节点; 调用者需持有loop->lock且已将节点移出链表 */
+static int _leda_mainloop_release(leda_mainloop_t *loop, leda_mainloop_pin_t *pin)
+{
+    pin->dead = 1;
+    if ((pin->pinned > 0) && pthread_equal(pin->owner, pthread_self()))
+    {
+        pin->handoff = 1;
+        return 0;
+    }
+
+    while (pin->pinned > 0)
+    {
+        pthread_cond_wait(&loop->unpinned, &loop->lock);
+    }
+
+    return 1;
+}
+
+static uint64_t _leda_mainloop_now_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ * 按fd上所有使能的watch重新设置epoll监听事件; 调用者需持有loop->lock
+ * 注: 没有使能的watch时从epoll中删除, 否则挂断的连接会持续触发EPOLLHUP
+ */
+static void _leda_mainloop_update_fd(leda_mainloop_t *loop, int fd)
+{
+    leda_mainloop_watch_t   *pos    = NULL;
+    struct epoll_event      event;
+    unsigned int            flags   = 0;
+
+    list_for_each_entry(pos, &loop->watches, list_node)
+    {
+        if ((fd == dbus_watch_get_unix_fd(pos->watch)) && dbus_watch_get_enabled(pos->watch))
+        {
+            flags |= dbus_watch_get_flags(pos->watch);
+        }
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.data.fd = fd;
+    event.events  = ((flags & DBUS_WATCH_READABLE) ? EPOLLIN : 0) | ((flags & DBUS_WATCH_WRITABLE) ? EPOLLOUT : 0);
+    if (0 == event.events)
+    {
+        (void)epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        return;
+    }
+
+    if ((0 != epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &event))
+        && ((ENOENT != errno) || (0 != epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event))))
+    {
+        log_w(LEDA_TAG_NAME, "epoll ctl fd: %d failed: %s\n", fd, strerror(errno));
+    }
+}
+
+static dbus_bool_t _leda_mainloop_add_watch(DBusWatch *watch, void *data)
+{
+    leda_mainloop_t         *loop   = (leda_mainloop_t *)data;
+    leda_mainloop_watch_t   *node   = NULL;
+
+    node = (leda_mainloop_watch_t *)malloc(sizeof(leda_mainloop_watch_t));
+    if (NULL == node)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return FALSE;
+    }
+    memset(node, 0, sizeof(leda_mainloop_watch_t));
+    node->watch = watch;
+    dbus_watch_set_data(watch, node, NULL);
+
+    pthread_mutex_lock(&loop->lock);
+    list_add_tail(&node->list_node, &loop->watches);
+    _leda_mainloop_update_fd(loop, dbus_watch_get_unix_fd(watch));
+    pthread_mutex_unlock(&loop->lock);
+
+    return TRUE;
+}
+
+static void _leda_mainloop_remove_watch(DBusWatch *watch, void *data)
+{
+    leda_mainloop_t         *loop   = (leda_mainloop_t *)data;
+    leda_mainloop_watch_t   *node   = (leda_mainloop_watch_t *)dbus_watch_get_data(watch);
+    int                     release = 0;
+
+    if (NULL == node)
+    {
+        return;
+    }
+
+    dbus_watch_set_data(watch, NULL, NULL);
+
+    pthread_mutex_lock(&loop->lock);
+    list_del(&node->list_node);
+    _leda_mainloop_update_fd(loop, dbus_watch_get_unix_fd(watch));
+    release = _leda_mainloop_release(loop, &node->pin);
+    pthread_mutex_unlock(&loop->lock);
+
+    if (release)
+    {
+        free(node);
+    }
+}
+
+static void _leda_mainloop_toggle_watch(DBusWatch *watch, void *data)
+{
+    leda_mainloop_t *loop = (leda_mainloop_t *)data;
+
+    pthread_mutex_lock(&loop->lock);
+    _leda_mainloop_update_fd(loop, dbus_watch_get_unix_fd(watch));
+    pthread_mutex_unlock(&loop->lock);
+}
+
+/* 重新计算timeout的超时时间; 调用者需持有loop->lock */
+static void _leda_mainloop_arm_timeout(leda_mainloop_timeout_t *node)
+{
+    node->deadline = dbus_timeout_get_enabled(node->timeout)
+                     ? (_leda_mainloop_now_ms() + dbus_timeout_get_interval(node->timeout)) : 0;
+}
+
+static dbus_bool_t _leda_mainloop_add_timeout(DBusTimeout *timeout, void *data)
+{
+    leda_mainloop_t         *loop   = (leda_mainloop_t *)data;
+    leda_mainloop_timeout_t *node   = NULL;
+
+    node = (leda_mainloop_timeout_t *)malloc(sizeof(leda_mainloop_timeout_t));
+    if (NULL == node)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return FALSE;
+    }
+    memset(node, 0, sizeof(leda_mainloop_timeout_t));
+    node->timeout = timeout;
+    dbus_timeout_set_data(timeout, node, NULL);
+
+    pthread_mutex_lock(&loop->lock);
+    _leda_mainloop_arm_timeout(node);
+    list_add_tail(&node->list_node, &loop->timeouts);
+    pthread_mutex_unlock(&loop->lock);
+
+    /* 可能在其他线程中添加, 唤醒循环重新计算等待时间 */
+    leda_mainloop_wakeup(loop);
+
+    return TRUE;
+}
+
+static void _leda_mainloop_remove_timeout(DBusTimeout *timeout, void *data)
+{
+    leda_mainloop_t         *loop   = (leda_mainloop_t *)data;
+    leda_mainloop_timeout_t *node   = (leda_mainloop_timeout_t *)dbus_timeout_get_data(timeout);
+    int                     release = 0;
+
+    if (NULL == node)
+    {
+        return;
+    }
+
+    dbus_timeout_set_data(timeout, NULL, NULL);
+
+    pthread_mutex_lock(&loop->lock);
+    list_del(&node->list_node);
+    release = _leda_mainloop_release(loop, &node->pin);
+    pthread_mutex_unlock(&loop->lock);
+
+    if (release)
+    {
+        free(node);
+    }
+}
+
+static void _leda_mainloop_toggle_timeout(DBusTimeout *timeout, void *data)
+{
+    leda_mainloop_t         *loop   = (leda_mainloop_t *)data;
+    leda_mainloop_timeout_t *node   = (leda_mainloop_timeout_t *)dbus_timeout_get_data(timeout);
+
+    if (NULL == node)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&loop->lock);
+    _leda_mainloop_arm_timeout(node);
+    pthread_mutex_unlock(&loop->lock);
+
+    leda_mainloop_wakeup(loop);
+}
+
+/* 其他线程发送消息未能立即写出, 或读到消息放入接收队列时, 唤醒循环 */
+static void _leda_mainloop_wakeup_main(void *data)
+{
+    leda_mainloop_wakeup((leda_mainloop_t *)data);
+}
+
+static void _leda_mainloop_dispatch_status(DBusConnection *connection, DBusDispatchStatus status, void *data)
+{
+    if (DBUS_DISPATCH_DATA_REMAINS == status)
+    {
+        leda_mainloop_wakeup((leda_mainloop_t *)data);
+    }
+}
+
+/* 距最近一个timeout到期的毫秒数, 没有timeout时返回-1 */
+static int _leda_mainloop_next_timeout(leda_mainloop_t *loop)
+{
+    leda_mainloop_timeout_t *pos    = NULL;
+    uint64_t                now     = _leda_mainloop_now_ms();
+    uint64_t                nearest = 0;
+
+    pthread_mutex_lock(&loop->lock);
+    list_for_each_entry(pos, &loop->timeouts, list_node)
+    {
+        if ((0 != pos->deadline) && ((0 == nearest) || (pos->deadline < nearest)))
+        {
+            nearest = pos->deadline;
+        }
+    }
+    pthread_mutex_unlock(&loop->lock);
+
+    if (0 == nearest)
+    {
+        return -1;
+    }
+
+    return (nearest > now) ? (int)(nearest - now) : 0;
+}
+
+/*
+ * 处理fd上的读写事件
+ * 注: 调用dbus_watch_handle时不能持有loop->lock, libdbus会在持有连接锁时回调watch函数;
+ *     取出的watch被固定, 其他线程删除时等待处理结束; 处理前一个watch可能导致后一个被删除(如连接断开), 已删除的不再处理
+ */
+static void _leda_mainloop_handle_fd(leda_mainloop_t *loop, int fd, uint32_t events)
+{
+    leda_mainloop_watch_t   *pos    = NULL;
+    leda_mainloop_watch_t   *watches[MAINLOOP_HANDLE_NUM];
+    unsigned int            flags   = 0;
+    int                     count   = 0;
+    int                     i       = 0;
+    int                     valid   = 0;
+    int                     release = 0;
+
+    flags |= (events & EPOLLIN) ? DBUS_WATCH_READABLE : 0;
+    flags |= (events & EPOLLOUT) ? DBUS_WATCH_WRITABLE : 0;
+    flags |= (events & EPOLLHUP) ? DBUS_WATCH_HANGUP : 0;
+    flags |= (events & EPOLLERR) ? DBUS_WATCH_ERROR : 0;
+
+    pthread_mutex_lock(&loop->lock);
+    list_for_each_entry(pos, &loop->watches, list_node)
+    {
+        if ((count < MAINLOOP_HANDLE_NUM)
+            && (fd == dbus_watch_get_unix_fd(pos->watch))
+            && dbus_watch_get_enabled(pos->watch))
+        {
+            _leda_mainloop_pin(&pos->pin);
+            watches[count++] = pos;
+        }
+    }
+    pthread_mutex_unlock(&loop->lock);
+
+    for (i = 0; i < count; i++)
+    {
+        pthread_mutex_lock(&loop->lock);
+        valid = (!watches[i]->pin.dead) && dbus_watch_get_enabled(watches[i]->watch);
+        pthread_mutex_unlock(&loop->lock);
+
+        if (valid)
+        {
+            (void)dbus_watch_handle(watches[i]->watch,
+                                    flags & (dbus_watch_get_flags(watches[i]->watch) | DBUS_WATCH_HANGUP | DBUS_WATCH_ERROR));
+        }
+
+        pthread_mutex_lock(&loop->lock);
+        release = _leda_mainloop_unpin(loop, &watches[i]->pin);
+        pthread_mutex_unlock(&loop->lock);
+
+        if (release)
+        {
+            free(watches[i]);
+        }
+    }
+}
+
+/* 处理所有到期的timeout, 处理前按间隔重新计算下次超时时间 */
+static void _leda_mainloop_handle_timeouts(leda_mainloop_t *loop)
+{
+    leda_mainloop_timeout_t *pos    = NULL;
+    leda_mainloop_timeout_t *timeouts[MAINLOOP_HANDLE_NUM];
+    uint64_t                now     = _leda_mainloop_now_ms();
+    int                     count   = 0;
+    int                     i       = 0;
+    int                     valid   = 0;
+    int                     release = 0;
+
+    pthread_mutex_lock(&loop->lock);
+    list_for_each_entry(pos, &loop->timeouts, list_node)
+    {
+        if ((count < MAINLOOP_HANDLE_NUM) && (0 != pos->deadline) && (pos->deadline <= now))
+        {
+            _leda_mainloop_arm_timeout(pos);
+            _leda_mainloop_pin(&pos->pin);
+            timeouts[count++] = pos;
+        }
+    }
+    pthread_mutex_unlock(&loop->lock);
+
+    for (i = 0; i < count; i++)
+    {
+        pthread_mutex_lock(&loop->lock);
+        valid = !timeouts[i]->pin.dead;
+        pthread_mutex_unlock(&loop->lock);
+
+        if (valid)
+        {
+            (void)dbus_timeout_handle(timeouts[i]->timeout);
+        }
+
+        pthread_mutex_lock(&loop->lock);
+        release = _leda_mainloop_unpin(loop, &timeouts[i]->pin);
+        pthread_mutex_unlock(&loop->lock);
+
+        if (release)
+        {
+            free(timeouts[i]);
+        }
+    }
+}
+
+/*
+ * 初始化事件循环, 并接管连接的watch, timeout及唤醒函数.
+ *
+ * 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_mainloop_init(leda_mainloop_t *loop, DBusConnection *connection)
+{
+    struct epoll_event  event;
+    int                 event_fd = -1;
+
+    /* 其他线程可能同时调用leda_mainloop_wakeup, event_fd最后才设置为有效值 */
+    loop->connection    = connection;
+    loop->event_fd      = -1;
+    INIT_LIST_HEAD(&loop->watches);
+    INIT_LIST_HEAD(&loop->timeouts);
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0)
+    {
+        log_w(LEDA_TAG_NAME, "epoll create failed: %s\n", strerror(errno));
+        return LE_ERROR_UNKNOWN;
+    }
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0)
+    {
+        log_w(LEDA_TAG_NAME, "eventfd create failed: %s\n", strerror(errno));
+        close(loop->epoll_fd);
+        return LE_ERROR_UNKNOWN;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.data.fd = event_fd;
+    event.events  = EPOLLIN;
+    if (0 != epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, event_fd, &event))
+    {
+        log_w(LEDA_TAG_NAME, "epoll ctl eventfd failed: %s\n", strerror(errno));
+        close(event_fd);
+        close(loop->epoll_fd);
+        return LE_ERROR_UNKNOWN;
+    }
+
+    pthread_mutex_init(&loop->lock, NULL);
+    pthread_cond_init(&loop->unpinned, NULL);
+    __sync_synchronize();
+    loop->event_fd = event_fd;
+
+    if (!dbus_connection_set_watch_functions(connection,
+                                             _leda_mainloop_add_watch,
+                                             _leda_mainloop_remove_watch,
+                                             _leda_mainloop_toggle_watch,
+                                             loop, NULL)
+        || !dbus_connection_set_timeout_functions(connection,
+                                                  _leda_mainloop_add_timeout,
+                                                  _leda_mainloop_remove_timeout,
+                                                  _leda_mainloop_toggle_timeout,
+                                                  loop, NULL))
+    {
+        log_w(LEDA_TAG_NAME, "set dbus watch functions failed\n");
+        leda_mainloop_destroy(loop);
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    dbus_connection_set_wakeup_main_function(connection, _leda_mainloop_wakeup_main, loop, NULL);
+    dbus_connection_set_dispatch_status_function(connection, _leda_mainloop_dispatch_status, loop, NULL);
+
+    return LE_SUCCESS;
+}
+
+/*
+ * 等待并处理一轮事件, 没有事件时阻塞直到fd可读写, timeout到期或被唤醒.
+ * 收到的消息由libdbus放入连接的接收队列, 调用者随后通过dbus_connection_pop_message取出.
+ *
+ * timeout_ms: 最长等待时间(毫秒), -1表示只由libdbus的timeout决定.
+ *
+ * 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_mainloop_iterate(leda_mainloop_t *loop, int timeout_ms)
+{
+    struct epoll_event  events[MAINLOOP_EVENT_NUM];
+    uint64_t            value   = 0;
+    int                 count   = 0;
+    int                 i       = 0;
+    int                 timeout = _leda_mainloop_next_timeout(loop);
+
+    if ((timeout_ms >= 0) && ((timeout < 0) || (timeout_ms < timeout)))
+    {
+        timeout = timeout_ms;
+    }
+
+    count = epoll_wait(loop->epoll_fd, events, MAINLOOP_EVENT_NUM, timeout);
+    if (count < 0)
+    {
+        if (EINTR == errno)
+        {
+            return LE_SUCCESS;
+        }
+
+        log_w(LEDA_TAG_NAME, "epoll wait failed: %s\n", strerror(errno));
+        return LE_ERROR_UNKNOWN;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (loop->event_fd == events[i].data.fd)
+        {
+            (void)read(loop->event_fd, &value, sizeof(value));
+            continue;
+        }
+
+        _leda_mainloop_handle_fd(loop, events[i].data.fd, events[i].events);
+    }
+
+    _leda_mainloop_handle_timeouts(loop);
+
+    return LE_SUCCESS;
+}
+
+/* 唤醒事件循环, 可在任意线程调用 */
+void leda_mainloop_wakeup(leda_mainloop_t *loop)
+{
+    uint64_t value = 1;
+
+    if (loop->event_fd >= 0)
+    {
+        (void)write(loop->event_fd, &value, sizeof(value));
+    }
+}
+
+/* 归还连接的watch, timeout及唤醒函数, 释放事件循环资源 */
+void leda_mainloop_destroy(leda_mainloop_t *loop)
+{
+    leda_mainloop_watch_t   *watch      = NULL;
+    leda_mainloop_watch_t   *next_watch = NULL;
+    leda_mainloop_timeout_t *timeout    = NULL;
+    leda_mainloop_timeout_t *next       = NULL;
+
+    if (loop->event_fd < 0)
+    {
+        return;
+    }
+
+    /* 替换回调函数时libdbus对已有watch和timeout调用原remove函数 */
+    dbus_connection_set_wakeup_main_function(loop->connection, NULL, NULL, NULL);
+    dbus_connection_set_dispatch_status_function(loop->connection, NULL, NULL, NULL);
+    (void)dbus_connection_set_watch_functions(loop->connection, NULL, NULL, NULL, NULL, NULL);
+    (void)dbus_connection_set_timeout_functions(loop->connection, NULL, NULL, NULL, NULL, NULL);
+
+    list_for_each_entry_safe(watch, next_watch, &loop->watches, list_node)
+    {
+        list_del(&watch->list_node);
+        dbus_watch_set_data(watch->watch, NULL, NULL);
+        free(watch);
+    }
+
+    list_for_each_entry_safe(timeout, next, &loop->timeouts, list_node)
+    {
+        list_del(&timeout->list_node);
+        dbus_timeout_set_data(timeout->timeout, NULL, NULL);
+        free(timeout);
+    }
+
+    close(loop->event_fd);
+    close(loop->epoll_fd);
+    loop->event_fd = -1;
+    pthread_cond_destroy(&loop->unpinned);
+    pthread_mutex_destroy(&loop->lock);
+}
+
+#if defined(__cplusplus) /* If this is a C++ compiler, use C linkage */
+}
+#endif
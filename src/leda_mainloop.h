@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2014-2019 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __LEDA_MAINLOOP_H
+#define __LEDA_MAINLOOP_H
+
+#if defined(__cplusplus) /* If this is a C++ compiler, use C linkage */
+extern "C"
+{
+#endif
+
+/*
+* 事件循环
+* 注: 基于epoll驱动libdbus的watch和timeout, 没有事件时阻塞等待, 不再周期性轮询;
+*     eventfd用于其他线程唤醒循环, 如模块退出, 其他线程发送消息后需要循环继续写出或分发.
+*/
+typedef struct leda_mainloop
+{
+    DBusConnection      *connection;
+    int                 epoll_fd;
+    int                 event_fd;               /* 唤醒事件, -1表示未初始化 */
+    pthread_mutex_t     lock;                   /* 保护watch和timeout链表, libdbus可能在任意线程中增删watch */
+    pthread_cond_t      unpinned;               /* 处理中的watch/timeout处理结束, 通知等待释放的删除方 */
+    struct list_head    watches;                /* 已注册的watch, 同一fd可能对应多个watch */
+    struct list_head    timeouts;               /* 已注册的timeout */
+} leda_mainloop_t;
+
+int  leda_mainloop_init(leda_mainloop_t *loop, DBusConnection *connection);
+int  leda_mainloop_iterate(leda_mainloop_t *loop, int timeout_ms);
+void leda_mainloop_wakeup(leda_mainloop_t *loop);
+void leda_mainloop_destroy(leda_mainloop_t *loop);
+
+#if defined(__cplusplus) /* If this is a C++ compiler, use C linkage */
+}
+#endif
+#endif
@@ -34,6 +34,7 @@
 #include "linux-list.h"
 #include "leda_base.h"
 #include "leda_trpool.h"
+#include "leda_mainloop.h"
 #include "leda_methodcb.h"
 
 #if defined(__cplusplus) /* If this is a C++ compiler, use C linkage */
@@ -44,10 +45,39 @@ extern "C"
 LIST_HEAD(leda_cb_head);
 pthread_mutex_t g_methodcb_list_lock;
 
-LIST_HEAD(leda_send_head);
-LIST_HEAD(leda_receive_head);
+#define LEDA_CLOUD_ID_HASH_NUM  1024        /* cloud_id哈希桶数目 */
+
+/* cloud_id哈希表, 与leda_cb_head共用g_methodcb_list_lock */
+static leda_device_info_t *g_cloud_id_hash[LEDA_CLOUD_ID_HASH_NUM];
+
+/* 设备列表版本, 设备增删及上下线时递增, 受g_methodcb_list_lock保护 */
+static unsigned int g_devlist_generation = 0;
+
+/* getDeviceList应答缓存, 按STATE_ONLINE, STATE_OFFLINE, STATE_ALL分别缓存 */
+static leda_devlist_cache_t g_devlist_cache[STATE_ALL + 1];
+static pthread_mutex_t g_devlist_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 pthread_mutex_t g_leda_reply_lock;
 
+#define LEDA_REPLY_HASH_NUM     256         /* serial_id哈希桶数目 */
+#define LEDA_REPLY_WHEEL_NUM    16          /* 时间轮槽数目, 每槽1秒, 须大于LEDA_REPLY_EXPIRE_SEC */
+#define LEDA_REPLY_EXPIRE_SEC   10          /* 无人认领的应答保留时间(秒) */
+#define LEDA_REPLY_MAX_ORPHANS  1024        /* 无人认领的应答数目上限 */
+
+/*
+ * 同步调用应答表, 以下变量均受g_leda_reply_lock保护.
+ * 等待中的调用和先于等待者到达的应答都按serial_id放入哈希表;
+ * 无人认领的应答同时挂在时间轮上, 过期后释放.
+ */
+static leda_reply_t     *g_reply_hash[LEDA_REPLY_HASH_NUM];
+static struct list_head g_reply_wheel[LEDA_REPLY_WHEEL_NUM];
+static uint64_t         g_reply_tick;       /* 时间轮已推进到的时间(单调时钟秒) */
+static int              g_reply_orphan_nums;/* 当前无人认领的应答数 */
+static unsigned long    g_reply_orphans;
+static unsigned long    g_reply_expired;
+static unsigned long    g_reply_drops;
+static struct list_head g_reply_async;      /* 等待应答的异步调用, 按超时时间排序 */
+
 LIST_HEAD(leda_device_configcb_head);
 pthread_mutex_t g_device_configcb_lock;
 
@@ -72,6 +102,26 @@ pthread_mutex_t g_device_configcb_lock;
     "</node>\n"
     
 static int g_run_state = RUN_STATE_NORMAL;
+static int g_request_timeout_ms = 0;
+
+/* 成员名查找表, 名字长度在编译期确定, 查找时先比较长度和首字符, 命中后才比较全串 */
+#define LEDA_MEMBER_ENTRY(name, id)     {name, sizeof(name) - 1, id}
+
+static const struct
+{
+    const char  *name;
+    size_t      len;
+    int         id;
+} g_leda_members[] = 
+{
+    LEDA_MEMBER_ENTRY(LEDA_DEV_METHOD_GET_PROPERTIES,  LEDA_MEMBER_GET_PROPERTIES),
+    LEDA_MEMBER_ENTRY(LEDA_DEV_METHOD_SET_PROPERTIES,  LEDA_MEMBER_SET_PROPERTIES),
+    LEDA_MEMBER_ENTRY(DMP_METHOD_CALLMETHOD,           LEDA_MEMBER_CALL_SERVICES),
+    LEDA_MEMBER_ENTRY(DMP_METHOD_INTROSPECT,           LEDA_MEMBER_INTROSPECT),
+    LEDA_MEMBER_ENTRY(LEDA_DRV_METHOD_GET_DEV_LIST,    LEDA_MEMBER_GET_DEV_LIST),
+    LEDA_MEMBER_ENTRY(DMP_CONFIGMANAGER_METHOD_NOTIFY, LEDA_MEMBER_CONFIG_NOTIFY),
+    LEDA_MEMBER_ENTRY(DMP_METHOD_RESULT_NOTIFY,        LEDA_MEMBER_RESULT_NOTIFY),
+};
 
 void leda_set_runstate(int state)
 {
@@ -85,22 +135,46 @@ void leda_set_runstate(int state)
     return;
 }
 
+int leda_get_runstate(void)
+{
+    return *(volatile int *)&g_run_state;
+}
+
+/* FNV-1a哈希 */
+static unsigned int _leda_cloud_id_hash(const char *cloud_id, size_t len)
+{
+    unsigned int    hash    = 2166136261u;
+    size_t          i       = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)cloud_id[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* 按cloud_id哈希查找设备, 消息分发热路径上调用, 不做内存分配 */
 leda_device_info_t *leda_get_methodcb_by_cloud_id(const char *cloud_id)
 {
-    leda_device_info_t *pos, *next, *device_info = NULL;
+    leda_device_info_t  *pos    = NULL;
+    size_t              len     = strlen(cloud_id);
+    unsigned int        hash    = _leda_cloud_id_hash(cloud_id, len);
 
     pthread_mutex_lock(&g_methodcb_list_lock);
-    list_for_each_entry_safe(pos, next, &leda_cb_head, list_node)
+    for (pos = g_cloud_id_hash[hash % LEDA_CLOUD_ID_HASH_NUM]; NULL != pos; pos = pos->hash_next)
     {
-        if (strcmp(pos->cloud_id, cloud_id) == 0)
+        if ((hash == pos->cloud_id_hash) 
+            && (len == pos->cloud_id_len) 
+            && (0 == memcmp(pos->cloud_id, cloud_id, len)))
         {
-            device_info = pos;
             break;
         }
     }
     pthread_mutex_unlock(&g_methodcb_list_lock);
 
-    return device_info;
+    return pos;
 }
 
 leda_device_info_t *leda_get_methodcb_by_device_handle(device_handle_t dev_handle)
@@ -155,7 +229,11 @@ void leda_set_methodcb_online(device_handle_t dev_handle, int state)
     {
         if (dev_handle == pos->dev_handle)
         {
-            pos->online = state;
+            if (state != pos->online)
+            {
+                pos->online = state;
+                g_devlist_generation++;
+            }
             break;
         }
     }
@@ -164,6 +242,32 @@ void leda_set_methodcb_online(device_handle_t dev_handle, int state)
     return;
 }
 
+/* 设备注册时一次生成接口名, 对象路径和Introspect应答, 之后上报和Introspect不再格式化字符串 */
+static int _leda_device_names_new(leda_device_info_t *device_info)
+{
+    size_t  interface_len   = sizeof(LEDA_DEVICE_WKN) - 1 + device_info->cloud_id_len;
+    size_t  introspect_len  = sizeof(LEDA_INTROSPECT_HEADER_STRING) - 1 
+                              + sizeof("<node>\n  <interface name=\"\">\n") - 1 
+                              + interface_len 
+                              + sizeof(LEDA_INTROSPECT_END_STRING) - 1;
+
+    /* 对象路径为'/'加接口名, 长度比接口名多1 */
+    device_info->interface = (char *)malloc((interface_len + 1) + (interface_len + 2) + (introspect_len + 1));
+    if (NULL == device_info->interface)
+    {
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    device_info->path       = device_info->interface + interface_len + 1;
+    device_info->introspect = device_info->path + interface_len + 2;
+
+    snprintf(device_info->interface, interface_len + 1, "%s%s", LEDA_DEVICE_WKN, device_info->cloud_id);
+    leda_wkn_to_path(device_info->interface, device_info->path);
+    snprintf(device_info->introspect, introspect_len + 1, "%s<node>\n  <interface name=\"%s\">\n%s", 
+        LEDA_INTROSPECT_HEADER_STRING, device_info->interface, LEDA_INTROSPECT_END_STRING);
+
+    return LE_SUCCESS;
+}
+
 leda_device_info_t * leda_insert_methodcb(const char *cloud_id, 
                                           device_handle_t dev_handle,
                                           const char *product_key,
@@ -174,6 +278,7 @@ leda_device_info_t * leda_insert_methodcb(const char *cloud_id,
                                           void *usr_data)
 {
     leda_device_info_t *device_info = NULL;
+    leda_device_info_t **bucket     = NULL;
 
     device_info = (leda_device_info_t *)malloc(sizeof(leda_device_info_t));
     if (NULL == device_info)
@@ -213,6 +318,8 @@ leda_device_info_t * leda_insert_methodcb(const char *cloud_id,
     }
     strcpy(device_info->dev_name, dev_name);
 
+    device_info->cloud_id_len               = strlen(cloud_id);
+    device_info->cloud_id_hash              = _leda_cloud_id_hash(cloud_id, device_info->cloud_id_len);
     device_info->dev_handle                 = dev_handle;
     device_info->service_output_max_count   = device_cb->service_output_max_count;
     device_info->call_service_cb            = device_cb->call_service_cb;
@@ -223,8 +330,22 @@ leda_device_info_t * leda_insert_methodcb(const char *cloud_id,
     device_info->is_local                   = is_local;
     device_info->online                     = STATE_OFFLINE;
 
+    if (LE_SUCCESS != _leda_device_names_new(device_info))
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        free(device_info->cloud_id);
+        free(device_info->product_key);
+        free(device_info->dev_name);
+        free(device_info);
+        return NULL;
+    }
+
     pthread_mutex_lock(&g_methodcb_list_lock);
     list_add(&device_info->list_node, &leda_cb_head);
+    bucket = &g_cloud_id_hash[device_info->cloud_id_hash % LEDA_CLOUD_ID_HASH_NUM];
+    device_info->hash_next  = *bucket;
+    *bucket                 = device_info;
+    g_devlist_generation++;
     pthread_mutex_unlock(&g_methodcb_list_lock);
 
     return device_info;
@@ -233,6 +354,7 @@ leda_device_info_t * leda_insert_methodcb(const char *cloud_id,
 void leda_remove_methodcb(device_handle_t dev_handle)
 {
     leda_device_info_t *device_info = NULL;
+    leda_device_info_t **link       = NULL;
 
     device_info = leda_get_methodcb_by_device_handle(dev_handle);
     if (NULL == device_info)
@@ -242,6 +364,16 @@ void leda_remove_methodcb(device_handle_t dev_handle)
 
     pthread_mutex_lock(&g_methodcb_list_lock);
     list_del(&device_info->list_node);
+    link = &g_cloud_id_hash[device_info->cloud_id_hash % LEDA_CLOUD_ID_HASH_NUM];
+    while ((NULL != *link) && (device_info != *link))
+    {
+        link = &(*link)->hash_next;
+    }
+    if (NULL != *link)
+    {
+        *link = device_info->hash_next;
+    }
+    g_devlist_generation++;
     if (device_info->cloud_id)
     {
         free(device_info->cloud_id);
@@ -257,6 +389,11 @@ void leda_remove_methodcb(device_handle_t dev_handle)
         free(device_info->product_key);
     }
 
+    if (device_info->interface)
+    {
+        free(device_info->interface);
+    }
+
     if (device_info)
     {
         free(device_info);
@@ -267,49 +404,227 @@ void leda_remove_methodcb(device_handle_t dev_handle)
     return;
 }
 
-static leda_reply_t *_leda_get_reply_from_reveive(uint32_t serial_id)
+static uint64_t _leda_reply_now_sec(void)
 {
-    struct timespec tout;
-    leda_reply_t *pos, *next, *bus_reply = NULL;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec;
+}
 
-    clock_gettime(CLOCK_REALTIME, &tout);
-    list_for_each_entry_safe(pos, next, &leda_receive_head, list_node)
+static leda_reply_t *_leda_reply_new(uint32_t serial_id, DBusMessage *reply)
+{
+    leda_reply_t        *bus_reply = NULL;
+    pthread_condattr_t  cond_attr;
+
+    bus_reply = (leda_reply_t *)malloc(sizeof(leda_reply_t));
+    if (NULL == bus_reply)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return NULL;
+    }
+    INIT_LIST_HEAD(&bus_reply->list_node);
+    bus_reply->hash_next = NULL;
+    bus_reply->serial_id = serial_id;
+    bus_reply->reply     = reply;
+    bus_reply->expire    = 0;
+    bus_reply->waiting   = 0;
+    bus_reply->complete  = NULL;
+    bus_reply->complete_arg = NULL;
+    bus_reply->deadline  = 0;
+    bus_reply->result    = LE_SUCCESS;
+
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&bus_reply->ready, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    return bus_reply;
+}
+
+static void _leda_reply_free(leda_reply_t *bus_reply)
+{
+    if (bus_reply->reply)
+    {
+        dbus_message_unref(bus_reply->reply);
+    }
+    pthread_cond_destroy(&bus_reply->ready);
+    free(bus_reply);
+}
+
+static leda_reply_t *_leda_reply_find(uint32_t serial_id)
+{
+    leda_reply_t *pos = NULL;
+
+    for (pos = g_reply_hash[serial_id % LEDA_REPLY_HASH_NUM]; NULL != pos; pos = pos->hash_next)
     {
         if (pos->serial_id == serial_id)
         {
-            bus_reply = pos;
             break;
         }
+    }
+
+    return pos;
+}
+
+static void _leda_reply_link(leda_reply_t *bus_reply)
+{
+    leda_reply_t **bucket = &g_reply_hash[bus_reply->serial_id % LEDA_REPLY_HASH_NUM];
+
+    bus_reply->hash_next = *bucket;
+    *bucket = bus_reply;
+}
+
+/* 从哈希表摘除, 无人认领的应答同时从时间轮摘除, 异步调用同时从超时链表摘除 */
+static void _leda_reply_unlink(leda_reply_t *bus_reply)
+{
+    leda_reply_t **link = &g_reply_hash[bus_reply->serial_id % LEDA_REPLY_HASH_NUM];
+
+    while ((NULL != *link) && (bus_reply != *link))
+    {
+        link = &(*link)->hash_next;
+    }
+    if (NULL != *link)
+    {
+        *link = bus_reply->hash_next;
+    }
+
+    list_del_init(&bus_reply->list_node);
+    if (!bus_reply->waiting)
+    {
+        g_reply_orphan_nums--;
+    }
+}
+
+static void *_leda_reply_complete_proc(void *arg)
+{
+    leda_reply_t *bus_reply = (leda_reply_t *)arg;
+
+    bus_reply->complete(bus_reply->reply, bus_reply->result, bus_reply->complete_arg);
+    _leda_reply_free(bus_reply);
+
+    return NULL;
+}
+
+/* 异步调用完成, 已从应答表摘除; 回调投递到线程池执行, 不占用分发线程, 线程池不可用时直接执行 */
+static void _leda_reply_complete(leda_reply_t *bus_reply, int result)
+{
+    CThread_task_attr attr;
+
+    bus_reply->result = result;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.priority = LEDA_POOL_PRIO_CONTROL;
+    if (LE_SUCCESS != leda_pool_add_task(&attr, &_leda_reply_complete_proc, (void *)bus_reply))
+    {
+        (void)_leda_reply_complete_proc((void *)bus_reply);
+    }
+}
+
+/* 推进时间轮到当前时间, 释放过期仍无人认领的应答 */
+static void _leda_reply_wheel_advance(uint64_t now)
+{
+    uint64_t        tick;
+    leda_reply_t    *pos, *next;
 
-        if ((tout.tv_sec-pos->tout.tv_sec) > 10)
+    if (now <= g_reply_tick)
+    {
+        return;
+    }
+
+    /* 间隔超过一圈时只需遍历一圈 */
+    if ((now - g_reply_tick) > LEDA_REPLY_WHEEL_NUM)
+    {
+        g_reply_tick = now - LEDA_REPLY_WHEEL_NUM;
+    }
+
+    for (tick = g_reply_tick + 1; tick <= now; tick++)
+    {
+        list_for_each_entry_safe(pos, next, &g_reply_wheel[tick % LEDA_REPLY_WHEEL_NUM], list_node)
         {
-            log_d(LEDA_TAG_NAME, "reply: %d timeout: %d\n", pos->serial_id, pos->tout.tv_sec);
-            list_del(&pos->list_node);
-            if(pos->reply)
+            if (pos->expire > now)
             {
-                dbus_message_unref(pos->reply);
+                continue;
             }
-            free(pos);
+
+            log_d(LEDA_TAG_NAME, "reply: %d expired\n", pos->serial_id);
+            _leda_reply_unlink(pos);
+            _leda_reply_free(pos);
+            g_reply_expired++;
         }
     }
+    g_reply_tick = now;
+}
 
-    return bus_reply;
+void leda_reply_init(void)
+{
+    int i = 0;
+
+    pthread_mutex_lock(&g_leda_reply_lock);
+    memset(g_reply_hash, 0, sizeof(g_reply_hash));
+    for (i = 0; i < LEDA_REPLY_WHEEL_NUM; i++)
+    {
+        INIT_LIST_HEAD(&g_reply_wheel[i]);
+    }
+    INIT_LIST_HEAD(&g_reply_async);
+    g_reply_tick        = _leda_reply_now_sec();
+    g_reply_orphan_nums = 0;
+    g_reply_orphans     = 0;
+    g_reply_expired     = 0;
+    g_reply_drops       = 0;
+    pthread_mutex_unlock(&g_leda_reply_lock);
 }
 
-static leda_reply_t *_leda_get_reply_from_send(uint32_t serial_id)
+/* 释放所有无人认领的应答, 未完成的异步调用以LE_ERROR_UNKNOWN完成, 同步等待中的调用由调用者自行释放 */
+void leda_reply_fail_async(void)
 {
-    leda_reply_t *pos, *next, *bus_reply = NULL;
+    leda_reply_t        *pos, *next;
+    struct list_head    pending;
+
+    INIT_LIST_HEAD(&pending);
 
-    list_for_each_entry_safe(pos, next, &leda_send_head, list_node)
+    pthread_mutex_lock(&g_leda_reply_lock);
+    list_for_each_entry_safe(pos, next, &g_reply_async, list_node)
     {
-        if (pos->serial_id == serial_id)
+        _leda_reply_unlink(pos);
+        list_add_tail(&pos->list_node, &pending);
+    }
+    pthread_mutex_unlock(&g_leda_reply_lock);
+
+    list_for_each_entry_safe(pos, next, &pending, list_node)
+    {
+        list_del_init(&pos->list_node);
+        _leda_reply_complete(pos, LE_ERROR_UNKNOWN);
+    }
+}
+
+void leda_reply_destroy(void)
+{
+    int             i = 0;
+    leda_reply_t    *pos, *next;
+
+    leda_reply_fail_async();
+
+    pthread_mutex_lock(&g_leda_reply_lock);
+    for (i = 0; i < LEDA_REPLY_WHEEL_NUM; i++)
+    {
+        list_for_each_entry_safe(pos, next, &g_reply_wheel[i], list_node)
         {
-            bus_reply = pos;
-            break;
+            _leda_reply_unlink(pos);
+            _leda_reply_free(pos);
         }
     }
+    pthread_mutex_unlock(&g_leda_reply_lock);
+}
 
-    return bus_reply;
+void leda_get_reply_stats(leda_pool_stats_t *stats)
+{
+    pthread_mutex_lock(&g_leda_reply_lock);
+    stats->reply_orphans = g_reply_orphans;
+    stats->reply_expired = g_reply_expired;
+    stats->reply_drops   = g_reply_drops;
+    pthread_mutex_unlock(&g_leda_reply_lock);
 }
 
 static int _leda_set_send_reply(uint32_t serial_id, DBusMessage *reply)
@@ -317,8 +632,8 @@ static int _leda_set_send_reply(uint32_t serial_id, DBusMessage *reply)
     leda_reply_t *bus_reply = NULL;
 
     pthread_mutex_lock(&g_leda_reply_lock);
-    bus_reply = _leda_get_reply_from_send(serial_id);
-    if (NULL == bus_reply)
+    bus_reply = _leda_reply_find(serial_id);
+    if ((NULL == bus_reply) || (!bus_reply->waiting) || (NULL != bus_reply->reply))
     {
         pthread_mutex_unlock(&g_leda_reply_lock);
         return LE_ERROR_UNKNOWN;
@@ -326,6 +641,15 @@ static int _leda_set_send_reply(uint32_t serial_id, DBusMessage *reply)
     
     log_d(LEDA_TAG_NAME, "method reply: %d\n", serial_id);
     bus_reply->reply = reply;
+    if (NULL != bus_reply->complete)
+    {
+        _leda_reply_unlink(bus_reply);
+        pthread_mutex_unlock(&g_leda_reply_lock);
+        _leda_reply_complete(bus_reply, LE_SUCCESS);
+
+        return LE_SUCCESS;
+    }
+    pthread_cond_signal(&bus_reply->ready);
     pthread_mutex_unlock(&g_leda_reply_lock);
 
     return LE_SUCCESS;
@@ -336,26 +660,32 @@ leda_reply_t *leda_insert_send_reply(uint32_t serial_id)
     leda_reply_t *bus_reply = NULL;
 
     pthread_mutex_lock(&g_leda_reply_lock);
-    bus_reply = _leda_get_reply_from_reveive(serial_id);
+    _leda_reply_wheel_advance(_leda_reply_now_sec());
+    bus_reply = _leda_reply_find(serial_id);
     if (NULL != bus_reply)
     {
-        list_del(&bus_reply->list_node);
-        list_add(&bus_reply->list_node, &leda_send_head);
+        if (bus_reply->waiting)
+        {
+            log_w(LEDA_TAG_NAME, "serial_id: %d is already waiting\n", serial_id);
+            pthread_mutex_unlock(&g_leda_reply_lock);
+            return NULL;
+        }
+
+        /* 应答先于等待者到达, 认领后从时间轮摘除 */
+        list_del_init(&bus_reply->list_node);
+        g_reply_orphan_nums--;
+        bus_reply->waiting = 1;
     }
     else
     {
-        bus_reply = (leda_reply_t *)malloc(sizeof(leda_reply_t));
-        if(NULL == bus_reply)
+        bus_reply = _leda_reply_new(serial_id, NULL);
+        if (NULL == bus_reply)
         {
-            log_w(LEDA_TAG_NAME, "no memory can allocate\n");
             pthread_mutex_unlock(&g_leda_reply_lock);
             return NULL;
         }
-        bus_reply->serial_id = serial_id;
-        bus_reply->reply     = NULL;
-        clock_gettime(CLOCK_REALTIME, &bus_reply->tout);
-
-        list_add(&bus_reply->list_node, &leda_send_head);
+        bus_reply->waiting = 1;
+        _leda_reply_link(bus_reply);
     }
     pthread_mutex_unlock(&g_leda_reply_lock);
 
@@ -364,27 +694,160 @@ leda_reply_t *leda_insert_send_reply(uint32_t serial_id)
     return bus_reply;
 }
 
-int leda_insert_receive_reply(uint32_t serial_id, DBusMessage *reply)
+/*
+ * 登记异步调用, 应答到达或超时后在线程池中调用complete, 且只调用一次.
+ * 应答先于登记到达时立即完成.
+ */
+int leda_insert_async_reply(uint32_t serial_id, int timeout_ms, leda_reply_callback complete, void *arg)
 {
-    leda_reply_t *bus_reply = NULL;
+    struct timespec now;
+    leda_reply_t    *bus_reply = NULL;
+    leda_reply_t    *pos       = NULL;
 
-    if (NULL == reply)
+    if (NULL == complete)
     {
         return LE_ERROR_INVAILD_PARAM;
     }
 
-    bus_reply = (leda_reply_t *)malloc(sizeof(leda_reply_t));
-    if(NULL == bus_reply)
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&g_leda_reply_lock);
+    /* 与leda_reply_fail_async在同一把锁下判断, 退出后不再登记异步调用 */
+    if (RUN_STATE_EXIT == g_run_state)
     {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        pthread_mutex_unlock(&g_leda_reply_lock);
+        return LE_ERROR_UNKNOWN;
+    }
+
+    _leda_reply_wheel_advance((uint64_t)now.tv_sec);
+    bus_reply = _leda_reply_find(serial_id);
+    if (NULL != bus_reply)
+    {
+        if (bus_reply->waiting)
+        {
+            log_w(LEDA_TAG_NAME, "serial_id: %d is already waiting\n", serial_id);
+            pthread_mutex_unlock(&g_leda_reply_lock);
+            return LE_ERROR_UNKNOWN;
+        }
+
+        _leda_reply_unlink(bus_reply);
+        bus_reply->waiting      = 1;
+        bus_reply->complete     = complete;
+        bus_reply->complete_arg = arg;
+        pthread_mutex_unlock(&g_leda_reply_lock);
+        _leda_reply_complete(bus_reply, LE_SUCCESS);
+
+        return LE_SUCCESS;
+    }
+
+    bus_reply = _leda_reply_new(serial_id, NULL);
+    if (NULL == bus_reply)
+    {
+        pthread_mutex_unlock(&g_leda_reply_lock);
         return LE_ERROR_ALLOCATING_MEM;
     }
-    bus_reply->serial_id = serial_id;
-    bus_reply->reply = reply;
-    clock_gettime(CLOCK_REALTIME, &bus_reply->tout);
+    bus_reply->waiting      = 1;
+    bus_reply->complete     = complete;
+    bus_reply->complete_arg = arg;
+    bus_reply->deadline     = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000 + timeout_ms;
+    _leda_reply_link(bus_reply);
+
+    /* 超时时间通常相同, 从尾部查找插入位置 */
+    list_for_each_entry_reverse(pos, &g_reply_async, list_node)
+    {
+        if (pos->deadline <= bus_reply->deadline)
+        {
+            break;
+        }
+    }
+    list_add(&bus_reply->list_node, &pos->list_node);
+    pthread_mutex_unlock(&g_leda_reply_lock);
+
+    log_i(LEDA_TAG_NAME, "insert async reply serial_id: %d\n", serial_id);
+
+    return LE_SUCCESS;
+}
+
+/*
+ * 完成已超时的异步调用并推进时间轮, 由主连接的分发线程调用.
+ * 返回距下一个异步调用超时的毫秒数, 有无人认领的应答时不超过下一次推进时间轮的间隔; 两者都没有时返回-1.
+ */
+int leda_reply_expire_async(void)
+{
+    int                 timeout = -1;
+    uint64_t            now_ms;
+    struct timespec     now;
+    leda_reply_t        *pos, *next;
+    struct list_head    expired;
+
+    INIT_LIST_HEAD(&expired);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_ms = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+    pthread_mutex_lock(&g_leda_reply_lock);
+    list_for_each_entry_safe(pos, next, &g_reply_async, list_node)
+    {
+        if (pos->deadline > now_ms)
+        {
+            timeout = (int)(pos->deadline - now_ms);
+            break;
+        }
+
+        _leda_reply_unlink(pos);
+        list_add_tail(&pos->list_node, &expired);
+    }
+
+    /* 没有新的调用时时间轮也需推进, 否则无人认领的应答一直留在表中 */
+    _leda_reply_wheel_advance((uint64_t)now.tv_sec);
+    if ((g_reply_orphan_nums > 0) && ((timeout < 0) || (timeout > (int)(1000 - now_ms % 1000))))
+    {
+        timeout = (int)(1000 - now_ms % 1000);
+    }
+    pthread_mutex_unlock(&g_leda_reply_lock);
+
+    list_for_each_entry_safe(pos, next, &expired, list_node)
+    {
+        log_w(LEDA_TAG_NAME, "async reply: %d timeout\n", pos->serial_id);
+        list_del_init(&pos->list_node);
+        _leda_reply_complete(pos, LE_ERROR_TIMEOUT);
+    }
+
+    return timeout;
+}
+
+int leda_insert_receive_reply(uint32_t serial_id, DBusMessage *reply)
+{
+    uint64_t        now;
+    leda_reply_t    *bus_reply = NULL;
+
+    if (NULL == reply)
+    {
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    now = _leda_reply_now_sec();
 
     pthread_mutex_lock(&g_leda_reply_lock);
-    list_add(&bus_reply->list_node, &leda_receive_head);
+    _leda_reply_wheel_advance(now);
+    if ((LEDA_REPLY_MAX_ORPHANS <= g_reply_orphan_nums) || (NULL != _leda_reply_find(serial_id)))
+    {
+        g_reply_drops++;
+        log_w(LEDA_TAG_NAME, "reply serial_id: %d dropped, orphans: %d\n", serial_id, g_reply_orphan_nums);
+        pthread_mutex_unlock(&g_leda_reply_lock);
+        return LE_ERROR_UNKNOWN;
+    }
+
+    bus_reply = _leda_reply_new(serial_id, reply);
+    if (NULL == bus_reply)
+    {
+        pthread_mutex_unlock(&g_leda_reply_lock);
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    bus_reply->expire = now + LEDA_REPLY_EXPIRE_SEC;
+    list_add_tail(&bus_reply->list_node, &g_reply_wheel[bus_reply->expire % LEDA_REPLY_WHEEL_NUM]);
+    _leda_reply_link(bus_reply);
+    g_reply_orphan_nums++;
+    g_reply_orphans++;
     pthread_mutex_unlock(&g_leda_reply_lock);
 
     log_i(LEDA_TAG_NAME, "insert receive reply serial_id: %d\n", serial_id);
@@ -400,46 +863,76 @@ void leda_remove_reply(leda_reply_t *bus_reply)
     }
 
     pthread_mutex_lock(&g_leda_reply_lock);
-    list_del(&bus_reply->list_node);
+    _leda_reply_unlink(bus_reply);
     pthread_mutex_unlock(&g_leda_reply_lock);
-    if (bus_reply->reply)
-    {
-        dbus_message_unref(bus_reply->reply);
-    }
-    free(bus_reply);
+    _leda_reply_free(bus_reply);
 
     return;
 }
 
+/* 等待应答到达, 分发线程收到应答后唤醒, 超时按单调时钟计算, 不受系统时间调整影响 */
 int leda_get_reply_params(leda_reply_t *bus_reply, int timeout_ms)
 {
-    int time_count = 0;
+    int             ret = LE_SUCCESS;
+    struct timespec deadline;
 
     if (NULL == bus_reply)
     {
         return LE_ERROR_UNKNOWN;
     }
 
-    while (timeout_ms > time_count)
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec  += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&g_leda_reply_lock);
+    while (NULL == bus_reply->reply)
     {
-        if (NULL != bus_reply->reply)
+        if (ETIMEDOUT == pthread_cond_timedwait(&bus_reply->ready, &g_leda_reply_lock, &deadline))
         {
-            return LE_SUCCESS;
+            ret = (NULL != bus_reply->reply) ? LE_SUCCESS : LE_ERROR_TIMEOUT;
+            break;
         }
-        time_count++;
-        usleep(1000);
     }
+    pthread_mutex_unlock(&g_leda_reply_lock);
 
-    return LE_ERROR_TIMEOUT;
+    return ret;
 }
 
-static int _leda_method_is_driver_message_proc(DBusMessage *message)
+/* 方法名或服务名转换为编号, 未知名字或NULL返回LEDA_MEMBER_UNKNOWN */
+static int _leda_member_lookup(const char *name)
 {
-    const char *method_name = NULL;
-    method_name = dbus_message_get_member(message);
+    size_t  len = 0;
+    size_t  i   = 0;
+
+    if (NULL == name)
+    {
+        return LEDA_MEMBER_UNKNOWN;
+    }
+
+    len = strlen(name);
+    for (i = 0; i < sizeof(g_leda_members) / sizeof(g_leda_members[0]); i++)
+    {
+        if ((len == g_leda_members[i].len) 
+            && (name[0] == g_leda_members[i].name[0]) 
+            && (!memcmp(name, g_leda_members[i].name, len)))
+        {
+            return g_leda_members[i].id;
+        }
+    }
+
+    return LEDA_MEMBER_UNKNOWN;
+}
 
-    if (!strcmp(method_name, DMP_METHOD_INTROSPECT)
-        || !strcmp(method_name, LEDA_DRV_METHOD_GET_DEV_LIST))
+static int _leda_method_is_driver_message_proc(int member)
+{
+    if ((LEDA_MEMBER_INTROSPECT == member)
+        || (LEDA_MEMBER_GET_DEV_LIST == member))
     {
         return 0;
     }
@@ -476,12 +969,11 @@ static void _leda_deviceconnect_message_proc(DBusConnection *connection, DBusMes
     return;
 }
 
-static void _leda_deviceconfig_message_proc(DBusConnection *connection, DBusMessage *message)
+static void _leda_deviceconfig_message_proc(DBusConnection *connection, DBusMessage *message, int member)
 {
     int                     ret = LE_ERROR_UNKNOWN;
     DBusMessage             *reply = NULL;
     DBusError               dbus_error;
-    const char              *method_name = NULL;
     char                    *key = NULL;
     char                    *value = NULL;
     char                    *result = NULL;
@@ -490,81 +982,249 @@ static void _leda_deviceconfig_message_proc(DBusConnection *connection, DBusMess
 
     reply = dbus_message_new_method_return(message);
 
-    method_name = dbus_message_get_member(message);
-    if (!strcmp(method_name, DMP_CONFIGMANAGER_METHOD_NOTIFY))
+    /* 方法名已在分发线程中解析为编号 */
+    switch (member)
     {
-        dbus_error_init(&dbus_error);
-        if (!dbus_message_get_args(message, &dbus_error, DBUS_TYPE_STRING, &key, DBUS_TYPE_STRING, &value, DBUS_TYPE_INVALID)
-            || (NULL == key))
+    case LEDA_MEMBER_CONFIG_NOTIFY:
         {
-            log_w(LEDA_TAG_NAME, "get args failed from dbus_message_get_args: %s\n", key);
-            return;
-        }
-        dbus_error_free(&dbus_error);
+            dbus_error_init(&dbus_error);
+            if (!dbus_message_get_args(message, &dbus_error, DBUS_TYPE_STRING, &key, DBUS_TYPE_STRING, &value, DBUS_TYPE_INVALID)
+                || (NULL == key))
+            {
+                log_w(LEDA_TAG_NAME, "get args failed from dbus_message_get_args: %s\n", key);
+                return;
+            }
+            dbus_error_free(&dbus_error);
 
-        pthread_mutex_lock(&g_device_configcb_lock);
-        list_for_each_entry_safe(pos, next, &leda_device_configcb_head, list_node)
-        {
-            if (strstr(key, pos->module_id))
+            /* 物模型变更由SDK自身订阅, 只刷新物模型缓存, 不通知驱动; 物模型扩展信息未缓存 */
+            if (!strncmp(key, CONFIGMANAGER_TSL_HEADER, strlen(CONFIGMANAGER_TSL_HEADER))
+                && strncmp(key, CONFIGMANAGER_TSL_CONFIG_HEADER, strlen(CONFIGMANAGER_TSL_CONFIG_HEADER)))
             {
-                ret = pos->device_configcb(value);
-                break;
+                ret = leda_tsl_cache_update(key + strlen(CONFIGMANAGER_TSL_HEADER), value);
+            }
+            else
+            {
+                pthread_mutex_lock(&g_device_configcb_lock);
+                list_for_each_entry_safe(pos, next, &leda_device_configcb_head, list_node)
+                {
+                    if (strstr(key, pos->module_id))
+                    {
+                        ret = pos->device_configcb(value);
+                        break;
+                    }
+                }
+                pthread_mutex_unlock(&g_device_configcb_lock);
             }
-        }
-        pthread_mutex_unlock(&g_device_configcb_lock);
         
-        result = leda_retmsg_create(ret, NULL);
+            result = leda_retmsg_create(ret, NULL);
+            dbus_message_append_args(reply, DBUS_TYPE_STRING, &result, DBUS_TYPE_INVALID);
+            dbus_connection_send(connection, reply, NULL);
+            leda_retmsg_free(result);
+            break;
+        }
+    default:
+        {
+            break;
+        }
+    }
+
+    dbus_message_unref(reply);
+
+    return;
+}
+
+static void *_leda_deviceconfig_message_task(void *arg)
+{
+    leda_notify_info_t *notify_info = (leda_notify_info_t *)arg;
+
+    _leda_deviceconfig_message_proc(notify_info->connection, notify_info->message, notify_info->member);
+    dbus_message_unref(notify_info->message);
+    free(notify_info);
+
+    return NULL;
+}
+
+/* 配置变更通知未执行被线程池丢弃(如模块退出), 直接回复错误码 */
+static void _leda_deviceconfig_message_discard(void *arg, int reason)
+{
+    leda_notify_info_t  *notify_info    = (leda_notify_info_t *)arg;
+    DBusMessage         *reply          = NULL;
+    char                *result         = NULL;
+
+    reply = dbus_message_new_method_return(notify_info->message);
+    if (NULL != reply)
+    {
+        result = leda_retmsg_create(reason, NULL);
         dbus_message_append_args(reply, DBUS_TYPE_STRING, &result, DBUS_TYPE_INVALID);
-        dbus_connection_send(connection, reply, NULL);
+        dbus_connection_send(notify_info->connection, reply, NULL);
         leda_retmsg_free(result);
+        dbus_message_unref(reply);
     }
 
-    dbus_message_unref(reply);
+    dbus_message_unref(notify_info->message);
+    free(notify_info);
+}
+
+/* 配置变更通知以最高优先级交给线程池串行执行, 避免驱动配置回调阻塞消息分发线程 */
+static void _leda_deviceconfig_message_send(DBusConnection *connection, DBusMessage *message, int member)
+{
+    leda_notify_info_t  *notify_info = NULL;
+    CThread_task_attr   attr;
+
+    notify_info = (leda_notify_info_t *)malloc(sizeof(leda_notify_info_t));
+    if (NULL == notify_info)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        _leda_deviceconfig_message_proc(connection, message, member);
+        return;
+    }
+    notify_info->connection = connection;
+    notify_info->message    = dbus_message_ref(message);
+    notify_info->member     = member;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.priority   = LEDA_POOL_PRIO_CONTROL;
+    attr.keyed      = 1;
+    attr.key        = (unsigned int)INVALID_DEVICE_HANDLE;
+    attr.discard    = &_leda_deviceconfig_message_discard;
+    if (LE_SUCCESS != leda_pool_add_task(&attr, &_leda_deviceconfig_message_task, (void *)notify_info))
+    {
+        _leda_deviceconfig_message_task((void *)notify_info);
+    }
+
+    return;
+}
+
+static void _leda_device_message_proc(DBusConnection *connection, DBusMessage *message, int member)
+{
+    log_d(LEDA_TAG_NAME, "method_name: %s \n", dbus_message_get_member(message));
+
+    if (LEDA_MEMBER_CONFIG_NOTIFY == member)
+    {
+        _leda_deviceconfig_message_send(connection, message, member);
+    }
+    else if (LEDA_MEMBER_RESULT_NOTIFY == member)
+    {
+        _leda_deviceconnect_message_proc(connection, message);
+    }
+
+    return;
+}
+
+/*
+ * 生成设备列表应答.
+ * 持g_methodcb_list_lock只复制符合状态的cloud_id, 释放锁后再构造和序列化JSON, 避免JSON处理阻塞设备查找.
+ * generation带出复制时的设备列表版本.
+ */
+static char *_leda_devlist_build(int online_state, unsigned int *generation)
+{
+    leda_device_info_t  *pos        = NULL;
+    leda_device_info_t  *next       = NULL;
+    cJSON               *object     = NULL;
+    cJSON               *sub_object = NULL;
+    cJSON               *item       = NULL;
+    char                *ids        = NULL;
+    char                *id         = NULL;
+    char                *buff       = NULL;
+    size_t              size        = 0;
+    int                 dev_cnt     = 0;
+    int                 i           = 0;
+
+    pthread_mutex_lock(&g_methodcb_list_lock);
+    list_for_each_entry_safe(pos, next, &leda_cb_head, list_node)
+    {
+        if ((STATE_ALL == online_state) || (online_state == pos->online))
+        {
+            size += pos->cloud_id_len + 1;
+            dev_cnt++;
+        }
+    }
+
+    ids = (char *)malloc(size + 1);
+    if (NULL == ids)
+    {
+        pthread_mutex_unlock(&g_methodcb_list_lock);
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return NULL;
+    }
+
+    id = ids;
+    list_for_each_entry_safe(pos, next, &leda_cb_head, list_node)
+    {
+        if ((STATE_ALL == online_state) || (online_state == pos->online))
+        {
+            memcpy(id, pos->cloud_id, pos->cloud_id_len + 1);
+            id += pos->cloud_id_len + 1;
+        }
+    }
+    *generation = g_devlist_generation;
+    pthread_mutex_unlock(&g_methodcb_list_lock);
+
+    item = cJSON_CreateArray();
+    for (i = 0, id = ids; i < dev_cnt; i++, id += strlen(id) + 1)
+    {
+        cJSON_AddItemToArray(item, cJSON_CreateString(id));
+    }
+    free(ids);
+
+    sub_object = cJSON_CreateObject();
+    cJSON_AddItemToObject(sub_object, "devList", item);
+    cJSON_AddNumberToObject(sub_object, "devNum", dev_cnt);
+
+    object = cJSON_CreateObject();
+    cJSON_AddItemToObject(object, "params", sub_object);
+    buff = cJSON_PrintUnformatted(object);
+    cJSON_Delete(object);
 
-    return;
+    return buff;
 }
 
-static void _leda_device_message_proc(DBusConnection *connection, DBusMessage *message)
+/* 设备列表应答追加到reply, 设备列表未变化时直接使用缓存 */
+static void _leda_devlist_reply(DBusMessage *reply, int online_state)
 {
-    const char *method_name = NULL;
-
-    method_name = dbus_message_get_member(message);
-    log_d(LEDA_TAG_NAME, "method_name: %s \n", method_name);
+    leda_devlist_cache_t    *cache      = &g_devlist_cache[online_state];
+    unsigned int            generation  = 0;
+    char                    *buff       = NULL;
 
-    if (!strcmp(method_name, DMP_CONFIGMANAGER_METHOD_NOTIFY))
+    pthread_mutex_lock(&g_devlist_cache_lock);
+    if ((NULL != cache->json) && (cache->generation == *(volatile unsigned int *)&g_devlist_generation))
     {
-        _leda_deviceconfig_message_proc(connection, message);
+        dbus_message_append_args(reply, DBUS_TYPE_STRING, &cache->json, DBUS_TYPE_INVALID);
+        pthread_mutex_unlock(&g_devlist_cache_lock);
+        return;
     }
-    else if(!strcmp(method_name, DMP_METHOD_RESULT_NOTIFY))
+    pthread_mutex_unlock(&g_devlist_cache_lock);
+
+    buff = _leda_devlist_build(online_state, &generation);
+    if (NULL == buff)
     {
-        _leda_deviceconnect_message_proc(connection, message);
+        return;
     }
 
-    return;
+    pthread_mutex_lock(&g_devlist_cache_lock);
+    if (NULL != cache->json)
+    {
+        cJSON_free(cache->json);
+    }
+    cache->json         = buff;
+    cache->generation   = generation;
+    dbus_message_append_args(reply, DBUS_TYPE_STRING, &cache->json, DBUS_TYPE_INVALID);
+    pthread_mutex_unlock(&g_devlist_cache_lock);
 }
 
-static void _leda_driver_message_proc(DBusConnection *connection, DBusMessage *message)
+static void _leda_driver_message_proc(DBusConnection *connection, DBusMessage *message, int member)
 {
 
     char                *driver_name    = NULL;
 
     DBusMessage         *reply          = NULL;
     DBusError           dbus_error;
-    const char          *method_name    = NULL;
-
-    cJSON               *object         = NULL;
-    cJSON               *sub_object     = NULL;
-    cJSON               *item           = NULL;
-    cJSON               *sub_item       = NULL;
 
-    leda_device_info_t  *pos            = NULL;
-    leda_device_info_t  *next           = NULL;
-
-    int                 dev_cnt         = 0;
     int                 online_state    = STATE_ALL;
 
     char                *buff           = NULL;
     char                *params         = NULL;
+    char                introspect[1024];
     
     if ((NULL != dbus_message_get_path(message)) 
         && (!strncmp(dbus_message_get_path(message), LEDA_DRIVER_PATH, strlen(LEDA_DRIVER_PATH))))
@@ -608,27 +1268,17 @@ static void _leda_driver_message_proc(DBusConnection *connection, DBusMessage *m
     if (DBUS_MESSAGE_TYPE_METHOD_CALL == dbus_message_get_type(message))
     {
         reply = dbus_message_new_method_return(message);
-        method_name = dbus_message_get_member(message);
-        if (!strcmp(method_name, DMP_METHOD_INTROSPECT))
+        if (LEDA_MEMBER_INTROSPECT == member)
         {
-            buff = (char *)malloc(1024);
-            if (NULL == buff)
-            {
-                dbus_connection_send(connection, reply, NULL);
-            }
-            else
-            {
-                memset(buff, 0, 1024);
-                snprintf(buff, 1024, "%s<node>\n  <interface name=\"%s%s\">\n%s", 
-                    LEDA_INTROSPECT_HEADER_STRING, LEDA_DRIVER_WKN, driver_name, LEDA_DRIVER_INTROSPECT_END_STRING);
-
-                log_d(LEDA_TAG_NAME, "introspect:%s\n", buff);
-                dbus_message_append_args(reply, DBUS_TYPE_STRING, &buff, DBUS_TYPE_INVALID);
-                dbus_connection_send(connection, reply, NULL);
-                free(buff);
-            }
+            snprintf(introspect, sizeof(introspect), "%s<node>\n  <interface name=\"%s%s\">\n%s", 
+                LEDA_INTROSPECT_HEADER_STRING, LEDA_DRIVER_WKN, driver_name, LEDA_DRIVER_INTROSPECT_END_STRING);
+
+            log_d(LEDA_TAG_NAME, "introspect:%s\n", introspect);
+            buff = introspect;
+            dbus_message_append_args(reply, DBUS_TYPE_STRING, &buff, DBUS_TYPE_INVALID);
+            dbus_connection_send(connection, reply, NULL);
         }
-        else if(!strcmp(method_name, LEDA_DRV_METHOD_GET_DEV_LIST))
+        else if (LEDA_MEMBER_GET_DEV_LIST == member)
         {
             dbus_error_init(&dbus_error);
             dbus_message_get_args(message, &dbus_error, DBUS_TYPE_STRING, &params, DBUS_TYPE_INVALID);
@@ -653,31 +1303,8 @@ static void _leda_driver_message_proc(DBusConnection *connection, DBusMessage *m
                 }
             }
 
-            item = cJSON_CreateArray();
-            pthread_mutex_lock(&g_methodcb_list_lock);
-            list_for_each_entry_safe(pos, next, &leda_cb_head, list_node)
-            {
-                if ((STATE_ALL == online_state) || (online_state == pos->online))
-                {
-                    sub_item = cJSON_CreateString((const char *)pos->cloud_id);
-                    cJSON_AddItemToArray(item, sub_item);
-                    dev_cnt++;
-                }
-            }
-            pthread_mutex_unlock(&g_methodcb_list_lock);
-
-            sub_object = cJSON_CreateObject();
-            cJSON_AddItemToObject(sub_object, "devList", item);
-            cJSON_AddNumberToObject(sub_object, "devNum", dev_cnt);
-            
-            object = cJSON_CreateObject();
-            cJSON_AddItemToObject(object, "params", sub_object);
-            buff = cJSON_PrintUnformatted(object);
-            dbus_message_append_args(reply, DBUS_TYPE_STRING, &buff, DBUS_TYPE_INVALID);
+            _leda_devlist_reply(reply, online_state);
             dbus_connection_send(connection, reply, NULL);
-
-            cJSON_free(buff);
-            cJSON_Delete(object);
         }
         dbus_message_unref(reply);
     }
@@ -686,51 +1313,148 @@ static void _leda_driver_message_proc(DBusConnection *connection, DBusMessage *m
     return;
 }
 
-static void _leda_introspect_proc(DBusConnection *connection, char *cloud_id, DBusMessage *reply)
+/* 已注册设备直接回复注册时生成的Introspect应答, 未注册设备临时生成 */
+static void _leda_introspect_proc(DBusConnection *connection, const char *cloud_id, DBusMessage *reply)
 {
-    char *introspect = NULL;
+    leda_device_info_t  *device_info    = NULL;
+    const char          *introspect     = NULL;
+    char                buff[1024];
 
-    introspect = (char *)malloc(1024);
-    if (NULL == introspect)
+    device_info = leda_get_methodcb_by_cloud_id(cloud_id);
+    if (NULL != device_info)
     {
-        dbus_connection_send(connection, reply, NULL);
-        dbus_message_unref(reply);
-        return;
+        introspect = device_info->introspect;
+    }
+    else
+    {
+        snprintf(buff, sizeof(buff), "%s<node>\n  <interface name=\"%s%s\">\n%s", 
+            LEDA_INTROSPECT_HEADER_STRING, LEDA_DEVICE_WKN, cloud_id, LEDA_INTROSPECT_END_STRING);
+        introspect = buff;
     }
-
-    memset(introspect, 0, 1024);
-    snprintf(introspect, 1024, "%s<node>\n  <interface name=\"%s%s\">\n%s", 
-        LEDA_INTROSPECT_HEADER_STRING, LEDA_DEVICE_WKN, cloud_id, LEDA_INTROSPECT_END_STRING);
 
     log_d(LEDA_TAG_NAME, "introspect:%s\n", introspect);
     dbus_message_append_args(reply, DBUS_TYPE_STRING, &introspect, DBUS_TYPE_INVALID);
     dbus_connection_send(connection, reply, NULL);
     dbus_message_unref(reply);
-    free(introspect);
 
     return;
 }
 
 static void _leda_method_reply_proc(DBusMessage *reply)
 {
-    if (LE_SUCCESS == _leda_set_send_reply(dbus_message_get_reply_serial(reply), reply))
+    /* 应答交出后可能已被等待者或异步回调释放, 之后不能再访问reply */
+    uint32_t serial_id = dbus_message_get_reply_serial(reply);
+
+    if (LE_SUCCESS == _leda_set_send_reply(serial_id, reply))
     {
-        log_i(LEDA_TAG_NAME, "serial:%d set success.\n", dbus_message_get_reply_serial(reply));
+        log_i(LEDA_TAG_NAME, "serial:%d set success.\n", serial_id);
         return;
     }
 
-    if (LE_SUCCESS == leda_insert_receive_reply(dbus_message_get_reply_serial(reply), reply))
+    if (LE_SUCCESS == leda_insert_receive_reply(serial_id, reply))
     {
-        log_i(LEDA_TAG_NAME, "serial:%d insert success.\n", dbus_message_get_reply_serial(reply));
+        log_i(LEDA_TAG_NAME, "serial:%d insert success.\n", serial_id);
         return;
     }
 
-    log_w(LEDA_TAG_NAME, "serial: %d reply proc failed.\n", dbus_message_get_reply_serial(reply));
+    log_w(LEDA_TAG_NAME, "serial: %d reply proc failed.\n", serial_id);
     dbus_message_unref(reply);
 
     return;
 }
 
+/* 拷贝字符串到请求内存块中, 返回下一个可用位置 */
+static char *_leda_methodcall_info_pack(char **dest, char *pos, const char *src, size_t len)
+{
+    if (NULL == src)
+    {
+        *dest = NULL;
+        return pos;
+    }
+
+    memcpy(pos, src, len + 1);
+    *dest = pos;
+
+    return pos + len + 1;
+}
+
+/*
+ * 创建请求信息, 结构体与所有字符串放在同一块内存中, 从线程池请求内存块分配, 只需一次分配和一次释放.
+ * params可以为NULL.
+ */
+static leda_methodcall_info_t *_leda_methodcall_info_new(const char *cloud_id, 
+                                                         const char *method_name, 
+                                                         const char *service_name, 
+                                                         const char *params)
+{
+    leda_methodcall_info_t  *methodcall_info    = NULL;
+    size_t                  cloud_id_len        = strlen(cloud_id);
+    size_t                  method_name_len     = strlen(method_name);
+    size_t                  service_name_len    = strlen(service_name);
+    size_t                  params_len          = (NULL != params) ? strlen(params) : 0;
+    char                    *pos                = NULL;
+
+    methodcall_info = (leda_methodcall_info_t *)leda_pool_alloc_request(sizeof(leda_methodcall_info_t) 
+                                                                        + cloud_id_len + 1 
+                                                                        + method_name_len + 1 
+                                                                        + service_name_len + 1 
+                                                                        + ((NULL != params) ? (params_len + 1) : 0));
+    if (NULL == methodcall_info)
+    {
+        return NULL;
+    }
+    memset(methodcall_info, 0, sizeof(leda_methodcall_info_t));
+
+    pos = (char *)(methodcall_info + 1);
+    pos = _leda_methodcall_info_pack(&methodcall_info->cloud_id, pos, cloud_id, cloud_id_len);
+    pos = _leda_methodcall_info_pack(&methodcall_info->method_name, pos, method_name, method_name_len);
+    pos = _leda_methodcall_info_pack(&methodcall_info->service_name, pos, service_name, service_name_len);
+    pos = _leda_methodcall_info_pack(&methodcall_info->params, pos, params, params_len);
+
+    return methodcall_info;
+}
+
+static void _leda_methodcall_info_free(leda_methodcall_info_t *methodcall_info)
+{
+    leda_pool_free_request(methodcall_info);
+}
+
+/* 请求未执行被线程池丢弃(如排队超时), 直接回复错误码 */
+static void _leda_methodcb_discard(void *arg, int reason)
+{
+    leda_methodcall_info_t  *methodcall_info    = (leda_methodcall_info_t *)arg;
+    char                    *info               = NULL;
+
+    log_w(LEDA_TAG_NAME, "discard request cloud_id: %s, service_name: %s, serial: %d, reason: %d\n", 
+                         methodcall_info->cloud_id, 
+                         methodcall_info->service_name, 
+                         dbus_message_get_reply_serial(methodcall_info->reply), 
+                         reason);
+
+    info = leda_retmsg_create(reason, NULL);
+    dbus_message_append_args(methodcall_info->reply, DBUS_TYPE_STRING, &info, DBUS_TYPE_INVALID);
+    dbus_connection_send(methodcall_info->connection, methodcall_info->reply, NULL);
+    leda_retmsg_free(info);
+    dbus_message_unref(methodcall_info->reply);
+
+    _leda_methodcall_info_free(methodcall_info);
+}
+
+/* 按请求类型确定线程池优先级 */
+static int _leda_methodcb_priority(int service)
+{
+    if (LEDA_MEMBER_GET_PROPERTIES == service)
+    {
+        return LEDA_POOL_PRIO_GET;
+    }
+    else if (LEDA_MEMBER_SET_PROPERTIES == service)
+    {
+        return LEDA_POOL_PRIO_SET;
+    }
+
+    return LEDA_POOL_PRIO_SERVICE;
+}
+
 static void *_leda_methodcb_proc(void *arg)
 {
     leda_methodcall_info_t  *methodcall_info    = (leda_methodcall_info_t *)arg;
@@ -765,7 +1489,7 @@ static void *_leda_methodcb_proc(void *arg)
                          device_info->dev_handle, 
                          dbus_message_get_reply_serial(methodcall_info->reply));
 
-    if (strcmp(methodcall_info->method_name, DMP_METHOD_CALLMETHOD))
+    if (LEDA_MEMBER_CALL_SERVICES != methodcall_info->method)
     {
         info = leda_retmsg_create(LE_ERROR_INVAILD_PARAM, NULL);
         goto END;
@@ -777,7 +1501,7 @@ static void *_leda_methodcb_proc(void *arg)
         item = cJSON_GetObjectItem(object, "params");
     }
 
-    if(!strcmp(methodcall_info->service_name, LEDA_DEV_METHOD_GET_PROPERTIES))
+    if (LEDA_MEMBER_GET_PROPERTIES == methodcall_info->service)
     {
         params_count = leda_transform_data_json_to_struct(device_info->product_key, methodcall_info->service_name, item, &dev_data_input);        
         if ((params_count == 0) || (NULL == dev_data_input))
@@ -793,7 +1517,7 @@ static void *_leda_methodcb_proc(void *arg)
         params = leda_transform_data_struct_to_string(dev_data_input, params_count);        
         info = leda_retmsg_create(ret, params);
     }
-    else if(!strcmp(methodcall_info->service_name, LEDA_DEV_METHOD_SET_PROPERTIES))
+    else if (LEDA_MEMBER_SET_PROPERTIES == methodcall_info->service)
     {
         params_count = leda_transform_data_json_to_struct(device_info->product_key, methodcall_info->service_name, item, &dev_data_input);
         if ((params_count == 0) || (NULL == dev_data_input))
@@ -850,30 +1574,7 @@ END:
     leda_retmsg_free(info);
     dbus_message_unref(methodcall_info->reply);
 
-    if (methodcall_info->cloud_id)
-    {
-        free(methodcall_info->cloud_id);
-    }
-
-    if (methodcall_info->method_name)
-    {
-        free(methodcall_info->method_name);
-    }
-
-    if (methodcall_info->service_name)
-    {
-        free(methodcall_info->service_name);
-    }
-
-    if (methodcall_info->params)
-    {
-        free(methodcall_info->params);
-    }
-
-    if (methodcall_info)
-    {
-        free(methodcall_info);
-    }
+    _leda_methodcall_info_free(methodcall_info);
 
     if (NULL != object)
     {
@@ -898,14 +1599,17 @@ END:
     return NULL;
 }
 
-static void _leda_methodcb_send(DBusConnection *connection, char *cloud_id, DBusMessage *call_msg, DBusMessage *reply)
+/* 解析设备方法调用并追加到批量提交缓存, 由分发线程在本轮消息处理完毕后统一提交 */
+static void _leda_methodcb_send(CThread_batch *batch, DBusConnection *connection, const leda_device_info_t *device_info, const char *cloud_id, DBusMessage *call_msg, int member, DBusMessage *reply)
 {
+    int                     ret              = LE_SUCCESS;
     const char              *method_name     = NULL;
     char                    *service_name    = NULL;
 
     char                    *params          = NULL;
     char                    *info            = NULL;
     leda_methodcall_info_t  *methodcall_info = NULL;
+    CThread_task_attr       attr;
 
     DBusError               dbus_error;
     
@@ -918,69 +1622,34 @@ static void _leda_methodcb_send(DBusConnection *connection, char *cloud_id, DBus
     }
     else
     {
-        methodcall_info = (leda_methodcall_info_t *)malloc(sizeof(leda_methodcall_info_t));
-        if (NULL == methodcall_info)
-        {
-            info = leda_retmsg_create(LE_ERROR_ALLOCATING_MEM, NULL);
-            goto END;
-        }
-        memset(methodcall_info, 0, sizeof(leda_methodcall_info_t));
-        
-        methodcall_info->cloud_id = (char *)malloc(strlen(cloud_id)+1);
-        if (NULL == methodcall_info->cloud_id)
+        if (LEDA_MEMBER_CALL_SERVICES != member)
         {
-            info = leda_retmsg_create(LE_ERROR_ALLOCATING_MEM, NULL);
+            log_w(LEDA_TAG_NAME, "unsupport method: %s\n", method_name);
+            info = leda_retmsg_create(LE_ERROR_INVAILD_PARAM, NULL);
             goto END;
         }
-        strcpy(methodcall_info->cloud_id, cloud_id);
-        
-        methodcall_info->method_name = (char *)malloc(strlen(method_name)+1);
-        if (NULL == methodcall_info->method_name)
+
+        dbus_message_get_args(call_msg, &dbus_error, DBUS_TYPE_STRING, &service_name, DBUS_TYPE_STRING, &params, DBUS_TYPE_INVALID);
+        if (NULL == service_name)
         {
-            info = leda_retmsg_create(LE_ERROR_ALLOCATING_MEM, NULL);
+            info = leda_retmsg_create(LE_ERROR_INVAILD_PARAM, NULL);
             goto END;
         }
-        strcpy(methodcall_info->method_name, method_name);
 
-        if (!strcmp(methodcall_info->method_name, DMP_METHOD_CALLMETHOD))
+        if (dbus_error_is_set(&dbus_error))
         {
-            dbus_message_get_args(call_msg, &dbus_error, DBUS_TYPE_STRING, &service_name, DBUS_TYPE_STRING, &params, DBUS_TYPE_INVALID);
-            if (NULL == service_name)
-            {
-                info = leda_retmsg_create(LE_ERROR_INVAILD_PARAM, NULL);
-                goto END;
-            }
-
-            if ((dbus_error_is_set(&dbus_error)) || (NULL == params))
-            {
-                methodcall_info->params = NULL;
-            }
-            else
-            {
-                methodcall_info->params = (char *)malloc(strlen(params)+1);
-                if (NULL == methodcall_info->params)
-                {
-                    info = leda_retmsg_create(LE_ERROR_ALLOCATING_MEM, NULL);
-                    goto END;
-                }
-                strcpy(methodcall_info->params, params);
-            }
-
-            methodcall_info->service_name = (char *)malloc(strlen(service_name)+1);
-            if (NULL == methodcall_info->service_name)
-            {
-                info = leda_retmsg_create(LE_ERROR_ALLOCATING_MEM, NULL);
-                goto END;
-            }
-            strcpy(methodcall_info->service_name, service_name);
+            params = NULL;
         }
-        else
+
+        methodcall_info = _leda_methodcall_info_new(cloud_id, method_name, service_name, params);
+        if (NULL == methodcall_info)
         {
-            log_w(LEDA_TAG_NAME, "unsupport method: %s\n", methodcall_info->method_name);
-            info = leda_retmsg_create(LE_ERROR_INVAILD_PARAM, NULL);
+            info = leda_retmsg_create(LE_ERROR_ALLOCATING_MEM, NULL);
             goto END;
         }
         
+        methodcall_info->method     = member;
+        methodcall_info->service    = _leda_member_lookup(methodcall_info->service_name);
         methodcall_info->connection = connection;
         methodcall_info->reply      = reply;
 
@@ -990,7 +1659,34 @@ static void _leda_methodcb_send(DBusConnection *connection, char *cloud_id, DBus
                              methodcall_info->service_name, 
                              dbus_message_get_reply_serial(reply), 
                              methodcall_info->params);
-        leda_pool_add_worker(&_leda_methodcb_proc, (void *)methodcall_info);
+
+        /* 同一设备的请求按到达顺序串行执行, 不同设备之间并行并按请求类型区分优先级 */
+        memset(&attr, 0, sizeof(attr));
+        attr.priority   = _leda_methodcb_priority(methodcall_info->service);
+        attr.keyed      = 1;
+        attr.key        = (unsigned int)device_info->dev_handle;
+        attr.timeout_ms = g_request_timeout_ms;
+        attr.discard    = &_leda_methodcb_discard;
+
+        /*
+         * 非阻塞的属性获取在设备空闲时直接在分发线程中执行并应答, 设备有排队请求时仍进入线程池以保持顺序.
+         * 物模型未缓存时加载需同步请求DMP, 而应答由分发线程接收, 此时也交给线程池执行.
+         */
+        if ((LEDA_MEMBER_GET_PROPERTIES == methodcall_info->service)
+            && (device_info->flags & LEDA_DEVICE_FLAG_NONBLOCKING_GET)
+            && (leda_pool_can_run_inline(batch, attr.key))
+            && (leda_tsl_cache_contains(device_info->product_key)))
+        {
+            leda_pool_run_inline(attr.priority, &_leda_methodcb_proc, (void *)methodcall_info);
+            goto END;
+        }
+
+        ret = leda_pool_batch_add(batch, &attr, &_leda_methodcb_proc, (void *)methodcall_info);
+        if (LE_SUCCESS != ret)
+        {
+            info = leda_retmsg_create(ret, NULL);
+            goto END;
+        }
     }
 
 END:
@@ -1003,27 +1699,7 @@ END:
 
         if (methodcall_info)
         {
-            if (methodcall_info->cloud_id)
-            {
-                free(methodcall_info->cloud_id);
-            }
-
-            if (methodcall_info->method_name)
-            {
-                free(methodcall_info->method_name);
-            }
-
-            if (methodcall_info->service_name)
-            {
-                free(methodcall_info->service_name);
-            }
-
-            if (methodcall_info->params)
-            {
-                free(methodcall_info->params);
-            }
-
-            free(methodcall_info);
+            _leda_methodcall_info_free(methodcall_info);
         }
     }
     dbus_error_free(&dbus_error);
@@ -1031,143 +1707,176 @@ END:
     return;
 }
 
-void *leda_methodcb_thread(void *arg)
+/*
+ * 从消息的路径, 接口或目的名中取出设备cloud_id, 不匹配设备消息时返回NULL.
+ * 返回值指向消息内部字符串的后缀, 无需拷贝和释放, 在消息释放前有效.
+ */
+const char *leda_methodcb_route(DBusMessage *message)
 {
-    leda_connect_info_t *connect_info = (leda_connect_info_t *)arg;
-    int                 msg_type;
-    DBusMessage         *message      = NULL;
-    DBusMessage         *reply        = NULL;
-    const char          *method_name  = NULL;
-    char                *cloud_id     = NULL;
+    const char *name = NULL;
 
-    log_d(LEDA_TAG_NAME, "starting leda_method_thread 0x%lx\n", pthread_self());
+    name = dbus_message_get_path(message);
+    if (LE_SUCCESS == leda_path_is_vaild(name))
+    {
+        return name + sizeof(LEDA_PATH_NAME) - 1;
+    }
 
-    if ((NULL == connect_info) || (NULL == connect_info->connection))
+    name = dbus_message_get_interface(message);
+    if (LE_SUCCESS == leda_interface_is_vaild(name))
     {
-        log_w(LEDA_TAG_NAME, "connect_info is invalid\n");
-        pthread_exit(NULL);
+        return name + sizeof(LEDA_DEVICE_WKN) - 1;
     }
 
-    leda_pool_init(connect_info->trpool_num);
+    name = dbus_message_get_destination(message);
+    if (LE_SUCCESS == leda_interface_is_vaild(name))
+    {
+        return name + sizeof(LEDA_DEVICE_WKN) - 1;
+    }
 
-    prctl(PR_SET_NAME, "leda_dbus_loop_thread");
-    while (dbus_connection_get_is_connected(connect_info->connection))
+    return NULL;
+}
+
+/* 处理一条收到的消息, 处理完毕后释放消息; 设备方法调用追加到batch中 */
+static void _leda_methodcb_message_proc(leda_connect_info_t *connect_info, CThread_batch *batch, DBusMessage *message)
+{
+    DBusConnection      *connection   = connect_info->connection;
+    int                 msg_type;
+    DBusMessage         *reply        = NULL;
+    const char          *cloud_id     = NULL;
+    leda_device_info_t  *device_info  = NULL;
+    int                 member        = LEDA_MEMBER_UNKNOWN;
+
+    msg_type = dbus_message_get_type(message);
+    if (DBUS_MESSAGE_TYPE_METHOD_RETURN == msg_type)
     {
-        dbus_connection_read_write(connect_info->connection, 10);
-        do
+        /* 同步调用只在主连接上发出; 分片连接上只有申请设备WKN的应答, 各连接序号独立, 不能混入应答链表 */
+        if (0 == connect_info->index)
         {
-            message = dbus_connection_pop_message(connect_info->connection);
-            if (message == NULL)
-            {
-                break;
-            }
+            _leda_method_reply_proc(message);
+        }
+        else
+        {
+            dbus_message_unref(message);
+        }
+        return;
+    }
 
-            msg_type = dbus_message_get_type(message);
-            if (DBUS_MESSAGE_TYPE_METHOD_RETURN == msg_type)
-            {
-                _leda_method_reply_proc(message);
-                continue;
-            }
+    /* 方法名只在入口处查表一次, 之后按编号分支 */
+    if (DBUS_MESSAGE_TYPE_METHOD_CALL == msg_type)
+    {
+        member = _leda_member_lookup(dbus_message_get_member(message));
+    }
 
-            if (LE_SUCCESS == leda_path_is_vaild(dbus_message_get_path(message)))
+    cloud_id = leda_methodcb_route(message);
+    if (NULL == cloud_id)
+    {   
+        if (NULL != dbus_message_get_interface(message) 
+            && !strcmp(DBUS_PROPERTIES_CHANGE_INTERFACE, dbus_message_get_interface(message)))
+        {
+            reply = dbus_message_new_method_return(message);
+            dbus_connection_send(connection, reply, NULL);
+            dbus_message_unref(reply);
+        }
+        else
+        {
+            if (DBUS_MESSAGE_TYPE_METHOD_CALL == msg_type)
             {
-                cloud_id = (char *)malloc(strlen(dbus_message_get_path(message))-strlen(LEDA_PATH_NAME)+1);
-                if (NULL == cloud_id)
+                if (_leda_method_is_driver_message_proc(member))
                 {
-                    dbus_message_unref(message);
-                    continue;
+                    _leda_device_message_proc(connection, message, member);
                 }
-                snprintf(cloud_id, (strlen(dbus_message_get_path(message))-strlen(LEDA_PATH_NAME)+1), 
-                    "%s", dbus_message_get_path(message)+strlen(LEDA_PATH_NAME));
-            }
-            else if (LE_SUCCESS == leda_interface_is_vaild(dbus_message_get_interface(message)))
-            {
-                cloud_id = (char *)malloc(strlen(dbus_message_get_interface(message))-strlen(LEDA_DEVICE_WKN)+1);
-                if (NULL == cloud_id)
+                else
                 {
-                    dbus_message_unref(message);
-                    continue;
+                    _leda_driver_message_proc(connection, message, member);
                 }
-                snprintf(cloud_id, (strlen(dbus_message_get_interface(message))-strlen(LEDA_DEVICE_WKN)+1), 
-                    "%s", dbus_message_get_interface(message)+strlen(LEDA_DEVICE_WKN));
             }
-            else if (LE_SUCCESS == leda_interface_is_vaild(dbus_message_get_destination(message)))
+        }
+
+        dbus_message_unref(message);
+        return;
+    }
+
+    switch (msg_type)
+    {
+    case DBUS_MESSAGE_TYPE_METHOD_CALL:
+        {
+            reply = dbus_message_new_method_return(message);
+            if (LEDA_MEMBER_INTROSPECT == member)
             {
-                cloud_id = (char *)malloc(strlen(dbus_message_get_destination(message))-strlen(LEDA_DEVICE_WKN)+1);
-                if (NULL == cloud_id) 
-                {
-                    dbus_message_unref(message);
-                    continue;
-                }
-                snprintf(cloud_id, (strlen(dbus_message_get_destination(message))-strlen(LEDA_DEVICE_WKN)+1), 
-                    "%s", dbus_message_get_destination(message)+strlen(LEDA_DEVICE_WKN));
+                _leda_introspect_proc(connection, cloud_id, reply);
             }
             else
-            {   
-                if (NULL != dbus_message_get_interface(message) 
-                    && !strcmp(DBUS_PROPERTIES_CHANGE_INTERFACE, dbus_message_get_interface(message)))
-                {
-                    reply = dbus_message_new_method_return(message);
-                    dbus_connection_send(connect_info->connection, reply, NULL);
-                    dbus_message_unref(reply);
-                }
-                else
-                {
-                    msg_type = dbus_message_get_type(message);
-                    if (DBUS_MESSAGE_TYPE_METHOD_CALL == msg_type)
-                    {
-                        if (_leda_method_is_driver_message_proc(message))
-                        {
-                            _leda_device_message_proc(connect_info->connection, message);
-                        }
-                        else
-                        {
-                            _leda_driver_message_proc(connect_info->connection, message);
-                        }
-                    }
-                }
-
-                dbus_message_unref(message);
-                continue;
-            }
-
-            switch (msg_type)
             {
-            case DBUS_MESSAGE_TYPE_METHOD_CALL:
+                device_info = leda_get_methodcb_by_cloud_id(cloud_id);
+                if (NULL != device_info)
                 {
-                    reply = dbus_message_new_method_return(message);
-                    method_name = dbus_message_get_member(message);
-                    if (!strcmp(method_name, DMP_METHOD_INTROSPECT))
-                    {
-                        _leda_introspect_proc(connect_info->connection, cloud_id, reply);
-                    }
-                    else
-                    {
-                        if (NULL != leda_get_methodcb_by_cloud_id(cloud_id))
-                        {
-                            _leda_methodcb_send(connect_info->connection, cloud_id, message, reply);
-                        }
-                    }
-                    break;
+                    _leda_methodcb_send(batch, connection, device_info, cloud_id, message, member, reply);
                 }
-            default:
-                {
-                    break;
-                } 
-            }
-    
-            if (cloud_id)
-            {
-                free(cloud_id);
             }
-            dbus_message_unref(message);
-        } while(message != NULL);
+            break;
+        }
+    default:
+        {
+            break;
+        } 
+    }
+
+    dbus_message_unref(message);
+}
+
+/*
+ * 消息分发线程, 每个连接一个.
+ * 线程池和事件循环由调用者在启动前初始化; 退出时只退出循环, 排空线程池和释放连接由leda_exit负责.
+ */
+void *leda_methodcb_thread(void *arg)
+{
+    leda_connect_info_t *connect_info = (leda_connect_info_t *)arg;
+    DBusMessage         *message      = NULL;
+    CThread_batch       batch;
+    char                name[16];
+    int                 timeout       = -1;
+
+    log_d(LEDA_TAG_NAME, "starting leda_method_thread 0x%lx\n", pthread_self());
+
+    if ((NULL == connect_info) || (NULL == connect_info->connection))
+    {
+        log_w(LEDA_TAG_NAME, "connect_info is invalid\n");
+        pthread_exit(NULL);
+    }
+    g_request_timeout_ms = connect_info->config.request_timeout_ms;
 
-        if (RUN_STATE_EXIT == g_run_state)
+    if (0 == connect_info->index)
+    {
+        prctl(PR_SET_NAME, "leda_dbus_loop_thread");
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "leda_dbus_%d", connect_info->index);
+        prctl(PR_SET_NAME, name);
+    }
+    leda_pool_set_thread_sched(&(connect_info->config.dispatcher_sched));
+    leda_pool_batch_init(&batch);
+    while (dbus_connection_get_is_connected(connect_info->connection))
+    {
+        /* 先取完接收队列中已有的消息(可能由其他线程的阻塞调用读入), 再等待新事件 */
+        while (NULL != (message = dbus_connection_pop_message(connect_info->connection)))
+        {
+            _leda_methodcb_message_proc(connect_info, &batch, message);
+        }
+
+        /* 本轮收到的设备请求一次性投递到线程池 */
+        (void)leda_pool_batch_commit(&batch);
+
+        if (RUN_STATE_EXIT == *(volatile int *)&g_run_state)
+        {
+            return NULL;
+        }
+
+        /* 主连接负责异步调用超时, 等待时间不超过最近一个异步调用的超时时间 */
+        timeout = (0 == connect_info->index) ? leda_reply_expire_async() : -1;
+        if (LE_SUCCESS != leda_mainloop_iterate(&(connect_info->mainloop), timeout))
         {
-            leda_pool_destroy();
-            free(connect_info);
-            pthread_exit(NULL);
+            break;
         }
     }
 
@@ -47,6 +47,13 @@ typedef struct leda_device_info {
     int                         service_output_max_count;  /* 设备服务回调结果数组最大长度 */
     int                         is_local_name;
     int                         is_local;
+    struct leda_device_info     *hash_next;                 /* cloud_id哈希桶链表 */
+    unsigned int                cloud_id_hash;              /* cloud_id哈希值 */
+    size_t                      cloud_id_len;               /* cloud_id长度 */
+    char                        *interface;                 /* 设备接口名, 即设备WKN, 与path和introspect共用一块内存 */
+    char                        *path;                      /* 设备对象路径 */
+    char                        *introspect;                /* 设备Introspect应答 */
+    int                         flags;                      /* 设备标志, 参考LEDA_DEVICE_FLAG_* */
 } leda_device_info_t;
 
 typedef struct leda_methodcall_info {
@@ -54,20 +61,47 @@ typedef struct leda_methodcall_info {
     char            *method_name;
     char            *service_name;
     char            *params;
+    int             method;         /* method_name编号, 参考leda_member_e */
+    int             service;        /* service_name编号, 自定义服务为LEDA_MEMBER_UNKNOWN */
     DBusConnection  *connection;
     DBusMessage     *reply;
 }leda_methodcall_info_t;
 
-typedef struct leda_connect_info {
-    int             trpool_num;
+typedef struct leda_notify_info {
     DBusConnection  *connection;
+    DBusMessage     *message;
+    int             member;         /* 已解析的方法编号, 参考leda_member_e */
+}leda_notify_info_t;
+
+typedef struct leda_connect_info {
+    leda_init_config_t  config;
+    DBusConnection      *connection;
+    int                 index;          /* 连接编号, 0为主连接, 其余为按cloud_id分片的设备连接 */
+    leda_mainloop_t     mainloop;       /* 连接的事件循环 */
+    pthread_t           thread_id;      /* 消息分发线程 */
 } leda_connect_info_t;
 
+/* getDeviceList应答缓存, 设备列表版本变化后重新生成 */
+typedef struct leda_devlist_cache {
+    char                *json;          /* 序列化后的应答 */
+    unsigned int        generation;     /* 生成时的设备列表版本 */
+} leda_devlist_cache_t;
+
+/* 异步调用完成回调, reply为应答消息, 超时或失败时为NULL; ret为LE_SUCCESS或错误码 */
+typedef void (*leda_reply_callback)(DBusMessage *reply, int ret, void *arg);
+
 typedef struct leda_reply {
-    struct list_head    list_node;
+    struct list_head    list_node;      /* 无人认领时所在的时间轮槽链表, 异步调用时所在的超时链表 */
+    struct leda_reply   *hash_next;     /* serial_id哈希桶链表 */
     uint32_t            serial_id;
     DBusMessage         *reply;
-    struct timespec     tout;
+    uint64_t            expire;         /* 无人认领时的过期时间(单调时钟秒) */
+    int                 waiting;        /* 是否有调用者在等待, 0表示应答先到达或无人等待 */
+    pthread_cond_t      ready;          /* 应答到达通知, 使用单调时钟, 由g_leda_reply_lock保护 */
+    leda_reply_callback complete;       /* 异步调用完成回调, NULL表示同步等待 */
+    void                *complete_arg;  /* 异步调用完成回调参数 */
+    uint64_t            deadline;       /* 异步调用超时时间(单调时钟毫秒) */
+    int                 result;         /* 异步调用结果 */
 } leda_reply_t;
 
 typedef struct leda_device_configcb {
@@ -77,6 +111,7 @@ typedef struct leda_device_configcb {
 } leda_device_configcb_t;
 
 void leda_set_runstate(int state);
+int leda_get_runstate(void);
 
 leda_device_info_t *leda_get_methodcb_by_cloud_id(const char *cloud_id);
 leda_device_info_t *leda_get_methodcb_by_device_handle(device_handle_t dev_handle);
@@ -93,9 +128,16 @@ leda_device_info_t * leda_insert_methodcb(const char *cloud_id,
                                           void *usr_data);
 void leda_remove_methodcb(device_handle_t dev_handle);
 
+void leda_reply_init(void);
+void leda_reply_destroy(void);
+void leda_reply_fail_async(void);
+void leda_get_reply_stats(leda_pool_stats_t *stats);
 leda_reply_t *leda_insert_send_reply(uint32_t serial_id);
+int leda_insert_async_reply(uint32_t serial_id, int timeout_ms, leda_reply_callback complete, void *arg);
+int leda_reply_expire_async(void);
 void leda_remove_reply(leda_reply_t *bus_reply);
 int leda_get_reply_params(leda_reply_t *bus_reply, int timeout_ms);
+const char *leda_methodcb_route(DBusMessage *message);
 void *leda_methodcb_thread(void *arg);
 
 int leda_insert_device_configcb(const char *module_id, config_changed_callback onchanged_device_configcb);
@@ -8,6 +8,7 @@ OBJS = ./log/log.o \
 	   ./leda_base.o \
 	   ./leda_methodcb.o \
 	   ./leda_trpool.o \
+	   ./leda_mainloop.o \
 	   ./leda.o
 
 STATIC_LIB   = ../lib/libleda_sdk_c.a
@@ -16,6 +16,10 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -24,6 +28,12 @@
 #include <pthread.h>
 #include <assert.h>
 #include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 #include "log.h"
 #include "le_error.h"
@@ -36,169 +46,1786 @@ extern "C"
 {
 #endif
 
+#define TRPOOL_WORKER_SLOT_NUM  1024        /* 预分配任务槽数目 */
+#define TRPOOL_LANE_BUCKET_NUM  64          /* 串行通道哈希桶数目 */
+#define TRPOOL_PRIO_STARVE_NUM  16          /* 低优先级任务最多连续让出次数 */
+#define TRPOOL_REQUEST_NUM      256         /* 预分配请求内存块数目 */
+#define TRPOOL_REQUEST_SIZE     1024        /* 预分配请求内存块大小, 超过该大小的请求动态分配 */
+#define TRPOOL_SPAWN_WAIT_MS    10          /* 默认任务排队多久后新增线程 */
+#define TRPOOL_IDLE_TIMEOUT_MS  60000       /* 默认线程空闲多久后退出 */
+#define TRPOOL_DRAIN_TIMEOUT_MS 3000        /* 默认销毁时等待排队任务执行完毕的时间 */
+#define TRPOOL_EXIT_GRACE_MS    1000        /* 排空超时后等待执行中任务结束的时间 */
+
+#define TRPOOL_KICK_STEAL       0x1         /* 需唤醒其他队列上的空闲线程窃取任务 */
+#define TRPOOL_KICK_SPAWN       0x2         /* 需新增工作线程 */
+
 void *leda_thread_routine(void *arg);
 
 static CThread_pool *pool = NULL;
+static __thread int g_pool_worker = 0;      /* 当前线程是否为线程池工作线程 */
 
-void leda_pool_init (int max_thread_num)
+/* 从队列的任务槽空闲链表中取出一个任务, 槽用完时动态分配; 调用者需持有queue_lock */
+static CThread_worker *_leda_pool_alloc_worker(CThread_queue *queue)
 {
-    int i = 0;
+    CThread_worker *worker = queue->free_slots;
 
-    pool = (CThread_pool *)malloc(sizeof(CThread_pool));
-    if (NULL == pool)
+    if (NULL != worker)
     {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        return;
+        queue->free_slots = worker->next;
+        queue->slot_hits++;
+        return worker;
     }
 
-    (void)memset(pool, 0, sizeof(CThread_pool));
-    pthread_mutex_init(&(pool->queue_lock), NULL);
-    pthread_cond_init(&(pool->queue_ready), NULL);
-    pool->queue_head = NULL;
-    pool->threadid   = (pthread_t *)malloc(max_thread_num * sizeof(pthread_t));
-    if (NULL == pool->threadid)
+    queue->slot_fallbacks++;
+    return (CThread_worker *)malloc(sizeof(CThread_worker));
+}
+
+/* 
+ * 归还任务槽, 非预分配的任务直接释放; 调用者需持有queue_lock
+ * 注: 被窃取的任务槽归还到窃取时所在的队列, 槽只在持有所在队列锁时访问
+ */
+static void _leda_pool_free_worker(CThread_queue *queue, CThread_worker *worker)
+{
+    if ((worker >= pool->slots) && (worker < (pool->slots + pool->slot_nums)))
     {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        free(pool);
+        worker->next      = queue->free_slots;
+        queue->free_slots = worker;
         return;
     }
 
-    for (i = 0; i < max_thread_num; i++)
-    { 
-        (void)pthread_create(&(pool->threadid[i]), NULL, leda_thread_routine, NULL);
+    free(worker);
+}
+
+static uint64_t _leda_pool_now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static uint64_t _leda_pool_now_ms(void)
+{
+    return _leda_pool_now_us() / 1000;
+}
+
+/* 耗时计入直方图; 64位累计值在32位平台上没有无锁原子操作, 按优先级加锁更新 */
+static void _leda_pool_histogram_add(int priority, leda_latency_histogram_t *histogram, uint64_t us)
+{
+    int bucket = 0;
+
+    while ((bucket < LEDA_LATENCY_BUCKET_NUM - 1) && ((us >> bucket) != 0))
+    {
+        bucket++;
+    }
+
+    pthread_mutex_lock(&(pool->histogram_lock[priority]));
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->sum_us += (unsigned long long)us;
+    if (us > histogram->max_us)
+    {
+        histogram->max_us = (unsigned long long)us;
     }
+    pthread_mutex_unlock(&(pool->histogram_lock[priority]));
+}
 
-    pool->max_thread_num = max_thread_num;
-    pool->cur_queue_size = 0;
-    pool->shutdown       = 0;
+/* 任务追加到对应优先级的就绪链表尾; 调用者需持有queue_lock */
+static void _leda_pool_push_ready(CThread_queue *queue, CThread_worker *worker)
+{
+    CThread_list *list = &(queue->ready[worker->priority]);
 
-    return;
+    worker->next    = NULL;
+    worker->enqueue = _leda_pool_now_us();
+    if (NULL != list->tail)
+    {
+        list->tail->next = worker;
+    }
+    else
+    {
+        list->head = worker;
+    }
+    list->tail = worker;
+    queue->cur_queue_size++;
 }
 
-int leda_pool_add_worker (void *(*process)(void *arg), void *arg)
+/* 
+ * 取出优先级最高的就绪任务; 调用者需持有queue_lock
+ * 低优先级任务连续让出TRPOOL_PRIO_STARVE_NUM次后, 取优先级最低的任务执行一次
+ */
+static CThread_worker *_leda_pool_pop_ready(CThread_queue *queue)
 {
-    CThread_worker *newworker = (CThread_worker *)malloc(sizeof(CThread_worker));
-    if (NULL == newworker)
+    int             i       = 0;
+    int             highest = -1;
+    int             lowest  = -1;
+    int             prio    = -1;
+    CThread_list    *list   = NULL;
+    CThread_worker  *worker = NULL;
+
+    for (i = 0; i < LEDA_POOL_PRIO_BUTT; i++)
     {
-        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
-        return LE_ERROR_ALLOCATING_MEM;
+        if (NULL != queue->ready[i].head)
+        {
+            highest = (highest < 0) ? i : highest;
+            lowest  = i;
+        }
+    }
+
+    if (highest < 0)
+    {
+        return NULL;
+    }
+
+    prio = (queue->starve >= TRPOOL_PRIO_STARVE_NUM) ? lowest : highest;
+    queue->starve = (prio < lowest) ? (queue->starve + 1) : 0;
+
+    list    = &(queue->ready[prio]);
+    worker  = list->head;
+    list->head = worker->next;
+    if (NULL == list->head)
+    {
+        list->tail = NULL;
+    }
+    queue->cur_queue_size--;
+
+    return worker;
+}
+
+static int _leda_pool_is_elastic(void)
+{
+    return (pool->min_thread_num < pool->max_thread_num);
+}
+
+/* 队列中最早的就绪任务已等待的时间; 调用者需持有queue_lock */
+static uint64_t _leda_pool_oldest_wait(CThread_queue *queue)
+{
+    int         i       = 0;
+    uint64_t    now     = _leda_pool_now_us();
+    uint64_t    oldest  = now;
+
+    for (i = 0; i < LEDA_POOL_PRIO_BUTT; i++)
+    {
+        if ((NULL != queue->ready[i].head) && (queue->ready[i].head->enqueue < oldest))
+        {
+            oldest = queue->ready[i].head->enqueue;
+        }
+    }
+
+    return now - oldest;
+}
+
+/* 
+ * 新放入count个就绪任务后唤醒本队列上的等待线程, 最多唤醒count个; 调用者需持有queue_lock
+ * 返回TRPOOL_KICK_*标志, 需在释放queue_lock后调用_leda_pool_kick处理
+ */
+static int _leda_pool_signal_ready(CThread_queue *queue, int count)
+{
+    int i       = 0;
+    int flags   = 0;
+
+    for (i = 0; (i < count) && (i < queue->waiting); i++)
+    {
+        pthread_cond_signal(&(queue->queue_ready));
+    }
+
+    if (count <= queue->waiting)
+    {
+        return 0;
+    }
+
+    if (LEDA_POOL_MODE_STEALING == pool->mode)
+    {
+        flags |= TRPOOL_KICK_STEAL;
+    }
+
+    if (_leda_pool_is_elastic() && (_leda_pool_oldest_wait(queue) >= (uint64_t)pool->spawn_wait_ms * 1000))
+    {
+        flags |= TRPOOL_KICK_SPAWN;
     }
 
-    (void)memset(newworker, 0, sizeof(CThread_worker));
-    newworker->process  = process;
-    newworker->arg      = arg;
-    newworker->next     = NULL;
+    return flags;
+}
+
+/* 
+ * 任务放入就绪队列, 有线程在本队列上等待则直接唤醒; 调用者需持有queue_lock
+ * 返回TRPOOL_KICK_*标志, 需在释放queue_lock后调用_leda_pool_kick处理
+ */
+static int _leda_pool_submit_ready(CThread_queue *queue, CThread_worker *worker)
+{
+    _leda_pool_push_ready(queue, worker);
+
+    return _leda_pool_signal_ready(queue, 1);
+}
+
+/* 
+ * 窃取模式下唤醒任一其他队列上的等待线程来窃取任务; 调用者不能持有任何queue_lock
+ * 注: 先发布epoch再检查waiting, 休眠线程先置waiting再检查epoch, 二者至少有一方能看到对方, 不会丢失唤醒
+ */
+static void _leda_pool_wakeup_idle(CThread_queue *queue)
+{
+    int             i       = 0;
+    CThread_queue   *other  = NULL;
 
-    pthread_mutex_lock(&(pool->queue_lock));
-    CThread_worker *member = pool->queue_head;
-    if (member != NULL)
+    (void)__sync_add_and_fetch(&(pool->epoch), 1);
+    for (i = 0; i < pool->queue_nums; i++)
     {
-        while (member->next != NULL)
+        other = &(pool->queues[i]);
+        if ((other == queue) || (0 == *(volatile int *)&(other->waiting)))
+        {
+            continue;
+        }
+
+        pthread_mutex_lock(&(other->queue_lock));
+        if (other->waiting > 0)
         {
-            member = member->next;
+            pthread_cond_signal(&(other->queue_ready));
+            pthread_mutex_unlock(&(other->queue_lock));
+            return;
         }
-        member->next = newworker;
+        pthread_mutex_unlock(&(other->queue_lock));
+    }
+}
+
+/* 新增一个工作线程, 线程数已达上限时忽略; 调用者不能持有任何queue_lock */
+static void _leda_pool_spawn(int index)
+{
+    pthread_t threadid;
+
+    pthread_mutex_lock(&(pool->thread_lock));
+    if ((pool->shutdown) || (pool->cur_thread_num >= pool->max_thread_num))
+    {
+        pthread_mutex_unlock(&(pool->thread_lock));
+        return;
+    }
+    pool->cur_thread_num++;
+    pthread_mutex_unlock(&(pool->thread_lock));
+
+    if (0 != pthread_create(&threadid, &(pool->thread_attr), leda_thread_routine, (void *)(intptr_t)index))
+    {
+        log_w(LEDA_TAG_NAME, "create thread failed\n");
+        pthread_mutex_lock(&(pool->thread_lock));
+        pool->cur_thread_num--;
+        pthread_cond_broadcast(&(pool->thread_exit));
+        pthread_mutex_unlock(&(pool->thread_lock));
+        return;
+    }
+
+    log_d(LEDA_TAG_NAME, "thread pool spawn thread, threads: %d\n", pool->cur_thread_num);
+}
+
+/* 处理_leda_pool_submit_ready返回的标志; 调用者不能持有任何queue_lock */
+static void _leda_pool_kick(CThread_queue *queue, int flags)
+{
+    if (flags & TRPOOL_KICK_STEAL)
+    {
+        _leda_pool_wakeup_idle(queue);
+    }
+
+    if (flags & TRPOOL_KICK_SPAWN)
+    {
+        _leda_pool_spawn(0);
+    }
+}
+
+/* 串行任务固定投递到key对应的队列, 同一设备的任务在同一队列上保持缓存亲和 */
+static CThread_queue *_leda_pool_keyed_queue(unsigned int key)
+{
+    return &(pool->queues[key % pool->queue_nums]);
+}
+
+/* 查找key对应的活跃串行通道; 调用者需持有lane_lock */
+static CThread_lane *_leda_pool_find_lane(CThread_bucket *bucket, unsigned int key)
+{
+    CThread_lane *lane = bucket->lanes;
+
+    while ((NULL != lane) && (key != lane->key))
+    {
+        lane = lane->next;
+    }
+
+    return lane;
+}
+
+/* 新建串行通道并挂入哈希桶; 调用者需持有lane_lock */
+static CThread_lane *_leda_pool_new_lane(CThread_bucket *bucket, unsigned int key)
+{
+    CThread_lane *lane = bucket->free_lanes;
+
+    if (NULL != lane)
+    {
+        bucket->free_lanes = lane->next;
     }
     else
     {
-        pool->queue_head = newworker;
+        lane = (CThread_lane *)malloc(sizeof(CThread_lane));
+        if (NULL == lane)
+        {
+            return NULL;
+        }
     }
 
-    assert(pool->queue_head != NULL);
-    pool->cur_queue_size++;
-    pthread_mutex_unlock(&(pool->queue_lock));
+    lane->key       = key;
+    lane->head      = NULL;
+    lane->tail      = NULL;
+    lane->next      = bucket->lanes;
+    bucket->lanes   = lane;
+
+    return lane;
+}
 
-    pthread_cond_signal (&(pool->queue_ready));
+/* 通道当前任务执行完毕: 有后续任务则放入就绪队列, 否则回收通道 */
+static void _leda_pool_finish_lane(CThread_lane *lane)
+{
+    CThread_bucket  *bucket = &(pool->buckets[lane->key % TRPOOL_LANE_BUCKET_NUM]);
+    CThread_queue   *queue  = NULL;
+    CThread_lane    **link  = NULL;
+    CThread_worker  *worker = NULL;
+    int             flags   = 0;
 
-    return LE_SUCCESS;
+    pthread_mutex_lock(&(bucket->lane_lock));
+    worker = lane->head;
+    if (NULL != worker)
+    {
+        lane->head = worker->next;
+        if (NULL == lane->head)
+        {
+            lane->tail = NULL;
+        }
+
+        queue = _leda_pool_keyed_queue(lane->key);
+        pthread_mutex_lock(&(queue->queue_lock));
+        flags = _leda_pool_submit_ready(queue, worker);
+        pthread_mutex_unlock(&(queue->queue_lock));
+        pthread_mutex_unlock(&(bucket->lane_lock));
+        _leda_pool_kick(queue, flags);
+        return;
+    }
+
+    link = &(bucket->lanes);
+    while (*link != lane)
+    {
+        link = &(*link)->next;
+    }
+    *link = lane->next;
+
+    lane->next          = bucket->free_lanes;
+    bucket->free_lanes  = lane;
+    pthread_mutex_unlock(&(bucket->lane_lock));
 }
 
-int leda_pool_destroy(void)
+/* 
+ * 取一个待执行任务: 先取本线程队列, 窃取模式下再从其他队列头部窃取
+ * 返回时worker所占任务槽已归还, 任务内容通过参数带出
+ */
+static int _leda_pool_take_worker(int home, CThread_worker *task)
 {
-    int i;
-    CThread_worker *head = NULL;
+    int             i       = 0;
+    CThread_queue   *queue  = NULL;
+    CThread_worker  *worker = NULL;
 
-    if (pool->shutdown)
+    for (i = 0; i < pool->queue_nums; i++)
     {
-        return LE_ERROR_UNKNOWN;
+        queue = &(pool->queues[(home + i) % pool->queue_nums]);
+        if ((i > 0) && (0 == *(volatile int *)&(queue->cur_queue_size)))
+        {
+            continue;
+        }
+
+        pthread_mutex_lock(&(queue->queue_lock));
+        worker = _leda_pool_pop_ready(queue);
+        if (NULL != worker)
+        {
+            *task = *worker;
+            _leda_pool_free_worker(queue, worker);
+            pthread_mutex_unlock(&(queue->queue_lock));
+            return 1;
+        }
+        pthread_mutex_unlock(&(queue->queue_lock));
     }
-    pool->shutdown = 1;
 
-    /* 唤醒所有等待线程，线程池要销毁了 */
-    pthread_cond_broadcast(&(pool->queue_ready));
+    return 0;
+}
+
+/* 线程资源回收, 只在初始化失败和销毁时调用 */
+static void _leda_pool_free(void)
+{
+    int             i       = 0;
+    CThread_worker  *head   = NULL;
+    CThread_lane    *lane   = NULL;
 
-    /* 阻塞等待线程退出，否则就成僵尸了 */
-    for (i = 0; i < pool->max_thread_num; i++)
+    if (NULL != pool->queues)
     {
-        pthread_join(pool->threadid[i], NULL);
+        for (i = 0; i < pool->queue_nums; i++)
+        {
+            while (NULL != (head = _leda_pool_pop_ready(&(pool->queues[i]))))
+            {
+                _leda_pool_free_worker(&(pool->queues[i]), head);
+            }
+            pthread_mutex_destroy(&(pool->queues[i].queue_lock));
+            pthread_cond_destroy(&(pool->queues[i].queue_ready));
+        }
+        free(pool->queues);
     }
-    free(pool->threadid);
 
-    /* 销毁等待队列 */
-    while (pool->queue_head != NULL)
+    if (NULL != pool->buckets)
     {
-        head = pool->queue_head;
-        pool->queue_head = pool->queue_head->next;
-        free(head);
+        for (i = 0; i < TRPOOL_LANE_BUCKET_NUM; i++)
+        {
+            while (NULL != pool->buckets[i].lanes)
+            {
+                lane = pool->buckets[i].lanes;
+                pool->buckets[i].lanes = lane->next;
+                while (NULL != lane->head)
+                {
+                    head = lane->head;
+                    lane->head = head->next;
+                    if ((head < pool->slots) || (head >= (pool->slots + pool->slot_nums)))
+                    {
+                        free(head);
+                    }
+                }
+                free(lane);
+            }
+
+            while (NULL != pool->buckets[i].free_lanes)
+            {
+                lane = pool->buckets[i].free_lanes;
+                pool->buckets[i].free_lanes = lane->next;
+                free(lane);
+            }
+            pthread_mutex_destroy(&(pool->buckets[i].lane_lock));
+        }
+        free(pool->buckets);
     }
 
-    /* 条件变量和互斥量也别忘了销毁 */
-    pthread_mutex_destroy(&(pool->queue_lock));
-    pthread_cond_destroy(&(pool->queue_ready));
-    
+    for (i = 0; i < LEDA_POOL_PRIO_BUTT; i++)
+    {
+        pthread_mutex_destroy(&(pool->histogram_lock[i]));
+    }
+    pthread_mutex_destroy(&(pool->request_lock));
+    pthread_mutex_destroy(&(pool->thread_lock));
+    pthread_cond_destroy(&(pool->thread_exit));
+    pthread_cond_destroy(&(pool->monitor_wakeup));
+    pthread_attr_destroy(&(pool->thread_attr));
+    free(pool->requests);
+    free(pool->slots);
     free(pool);
-    pool=NULL;
+    pool = NULL;
+}
 
-    return LE_SUCCESS;
+/* 检查各队列, 最早的就绪任务排队超过spawn_wait_ms且无空闲线程时扩容 */
+static void _leda_pool_grow_stalled(void)
+{
+    int             i       = 0;
+    int             stalled = 0;
+    CThread_queue   *queue  = NULL;
+
+    for (i = 0; i < pool->queue_nums; i++)
+    {
+        queue = &(pool->queues[i]);
+
+        pthread_mutex_lock(&(queue->queue_lock));
+        stalled = (0 != queue->cur_queue_size) 
+                  && (0 == queue->waiting) 
+                  && (_leda_pool_oldest_wait(queue) >= (uint64_t)pool->spawn_wait_ms * 1000);
+        pthread_mutex_unlock(&(queue->queue_lock));
+
+        if (stalled)
+        {
+            _leda_pool_spawn(i);
+        }
+    }
 }
 
-void *leda_thread_routine(void *arg)
+/*
+ * 弹性线程池的监视线程, 每spawn_wait_ms检查一次积压.
+ * 提交和取任务时的扩容检查在所有线程都阻塞于回调且没有新请求时不会触发, 由本线程兜底.
+ */
+static void *_leda_pool_monitor_routine(void *arg)
 {
+    uint64_t        deadline = 0;
     struct timespec tout;
 
-    log_i(LEDA_TAG_NAME, "starting thread 0x%x\n", pthread_self());
+    (void)arg;
+    prctl(PR_SET_NAME, "leda_pool_monitor");
 
-    while (1)
+    pthread_mutex_lock(&(pool->thread_lock));
+    while (!(*(volatile int *)&(pool->draining)) && !pool->shutdown)
     {
-        clock_gettime(CLOCK_REALTIME, &tout);
-        tout.tv_sec += 1;
-        if(0 != pthread_mutex_timedlock(&(pool->queue_lock), &tout))
+        deadline     = _leda_pool_now_ms() + pool->spawn_wait_ms;
+        tout.tv_sec  = (time_t)(deadline / 1000);
+        tout.tv_nsec = (long)(deadline % 1000) * 1000000;
+        if (ETIMEDOUT != pthread_cond_timedwait(&(pool->monitor_wakeup), &(pool->thread_lock), &tout))
         {
             continue;
         }
 
-        /*  如果等待队列为0并且不销毁线程池，则处于阻塞状态; 
-            注意pthread_cond_wait是一个原子操作，等待前会解锁，唤醒后会加锁 */
-        while (pool->cur_queue_size == 0 && !pool->shutdown)
+        pthread_mutex_unlock(&(pool->thread_lock));
+        _leda_pool_grow_stalled();
+        pthread_mutex_lock(&(pool->thread_lock));
+    }
+    pthread_mutex_unlock(&(pool->thread_lock));
+
+    return NULL;
+}
+
+/* 停止监视线程, 需在置draining后调用; 调用者不能持有thread_lock */
+static void _leda_pool_stop_monitor(void)
+{
+    if (!pool->monitor_running)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&(pool->thread_lock));
+    pthread_cond_broadcast(&(pool->monitor_wakeup));
+    pthread_mutex_unlock(&(pool->thread_lock));
+
+    pthread_join(pool->monitor, NULL);
+    pool->monitor_running = 0;
+}
+
+/*
+ * 创建线程池.
+ *
+ * config->worker_thread_nums: 工作线程数.
+ * config->pool_mode:          调度模式, 共享模式所有线程竞争同一就绪队列; 窃取模式每个线程一个就绪队列, 空闲线程从其他队列窃取任务.
+ *
+ * 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_pool_init(const leda_init_config_t *config)
+{
+    int                 i           = 0;
+    int                 per_queue   = 0;
+    int                 thread_num  = 0;
+    pthread_condattr_t  cond_attr;
+
+    if ((NULL == config) || (config->worker_thread_nums <= 0))
+    {
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    pool = (CThread_pool *)malloc(sizeof(CThread_pool));
+    if (NULL == pool)
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+    (void)memset(pool, 0, sizeof(CThread_pool));
+
+    pool->mode              = config->pool_mode;
+    pool->max_thread_num    = config->worker_thread_nums;
+    pool->min_thread_num    = pool->max_thread_num;
+    pool->queue_nums        = (LEDA_POOL_MODE_STEALING == pool->mode) ? pool->max_thread_num : 1;
+    pool->spawn_wait_ms     = (config->thread_spawn_wait_ms > 0) ? config->thread_spawn_wait_ms : TRPOOL_SPAWN_WAIT_MS;
+    pool->idle_timeout_ms   = (config->thread_idle_timeout_ms > 0) ? config->thread_idle_timeout_ms : TRPOOL_IDLE_TIMEOUT_MS;
+    pool->drain_timeout_ms  = (config->shutdown_timeout_ms > 0) ? config->shutdown_timeout_ms : TRPOOL_DRAIN_TIMEOUT_MS;
+    pool->slot_nums         = TRPOOL_WORKER_SLOT_NUM;
+    pool->max_pending       = config->max_queue_size;
+    pool->high_watermark    = (config->queue_high_watermark > 0) ? config->queue_high_watermark : (config->max_queue_size * 3 / 4);
+    pool->low_watermark     = pool->high_watermark / 2;
+    pool->watermark_cb      = config->queue_watermark_cb;
+    pool->sched             = config->worker_sched;
+
+    /* 窃取模式每个线程绑定一个队列, 线程数固定 */
+    if ((config->min_thread_nums > 0) && (config->min_thread_nums < pool->max_thread_num))
+    {
+        if (LEDA_POOL_MODE_STEALING == pool->mode)
         {
-            log_d(LEDA_TAG_NAME, "thread 0x%x is waiting\n", pthread_self());
-            pthread_cond_wait(&(pool->queue_ready), &(pool->queue_lock));
+            log_w(LEDA_TAG_NAME, "elastic thread pool is not supported in stealing mode, use %d threads\n", pool->max_thread_num);
         }
+        else
+        {
+            pool->min_thread_num = config->min_thread_nums;
+        }
+    }
 
-        /* 线程池要销毁了 */
-        if (pool->shutdown)
+    pool->slots     = (CThread_worker *)malloc(pool->slot_nums * sizeof(CThread_worker));
+    pool->queues    = (CThread_queue *)malloc(pool->queue_nums * sizeof(CThread_queue));
+    pool->buckets   = (CThread_bucket *)malloc(TRPOOL_LANE_BUCKET_NUM * sizeof(CThread_bucket));
+    pool->requests  = (char *)malloc(TRPOOL_REQUEST_NUM * TRPOOL_REQUEST_SIZE);
+    if ((NULL == pool->slots) 
+        || (NULL == pool->queues) 
+        || (NULL == pool->buckets) 
+        || (NULL == pool->requests))
+    {
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        free(pool->slots);
+        free(pool->queues);
+        free(pool->buckets);
+        free(pool->requests);
+        free(pool);
+        pool = NULL;
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    pthread_mutex_init(&(pool->request_lock), NULL);
+    pthread_mutex_init(&(pool->thread_lock), NULL);
+    for (i = 0; i < LEDA_POOL_PRIO_BUTT; i++)
+    {
+        pthread_mutex_init(&(pool->histogram_lock[i]), NULL);
+    }
+    pthread_attr_init(&(pool->thread_attr));
+    pthread_attr_setdetachstate(&(pool->thread_attr), PTHREAD_CREATE_DETACHED);
+    if ((config->thread_stack_size > 0) 
+        && (0 != pthread_attr_setstacksize(&(pool->thread_attr), config->thread_stack_size)))
+    {
+        log_w(LEDA_TAG_NAME, "thread stack size: %d is invalid, use default\n", config->thread_stack_size);
+    }
+    for (i = TRPOOL_REQUEST_NUM - 1; i >= 0; i--)
+    {
+        CThread_request_block *block = (CThread_request_block *)(pool->requests + i * TRPOOL_REQUEST_SIZE);
+
+        block->next         = pool->free_requests;
+        pool->free_requests = block;
+    }
+
+    /* 预分配任务槽平均分给各队列 */
+    (void)memset(pool->queues, 0, pool->queue_nums * sizeof(CThread_queue));
+    per_queue = pool->slot_nums / pool->queue_nums;
+    for (i = 0; i < pool->slot_nums; i++)
+    {
+        CThread_queue *queue = &(pool->queues[(per_queue > 0) ? ((i / per_queue) % pool->queue_nums) : (i % pool->queue_nums)]);
+
+        pool->slots[i].next = queue->free_slots;
+        queue->free_slots   = &(pool->slots[i]);
+    }
+
+    /* 空闲线程超时退出及销毁时等待线程退出使用单调时钟, 不受系统时间调整影响 */
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&(pool->thread_exit), &cond_attr);
+    pthread_cond_init(&(pool->monitor_wakeup), &cond_attr);
+    for (i = 0; i < pool->queue_nums; i++)
+    {
+        pthread_mutex_init(&(pool->queues[i].queue_lock), NULL);
+        pthread_cond_init(&(pool->queues[i].queue_ready), &cond_attr);
+    }
+    pthread_condattr_destroy(&cond_attr);
+
+    (void)memset(pool->buckets, 0, TRPOOL_LANE_BUCKET_NUM * sizeof(CThread_bucket));
+    for (i = 0; i < TRPOOL_LANE_BUCKET_NUM; i++)
+    {
+        pthread_mutex_init(&(pool->buckets[i].lane_lock), NULL);
+    }
+
+    for (i = 0; i < pool->min_thread_num; i++)
+    { 
+        _leda_pool_spawn(i);
+    }
+
+    pthread_mutex_lock(&(pool->thread_lock));
+    thread_num = pool->cur_thread_num;
+    pthread_mutex_unlock(&(pool->thread_lock));
+    if (thread_num < pool->min_thread_num)
+    {
+        leda_pool_destroy();
+        return LE_ERROR_UNKNOWN;
+    }
+
+    /* 监视线程创建失败时, 仍可在提交和取任务时扩容 */
+    if (_leda_pool_is_elastic())
+    {
+        if (0 == pthread_create(&(pool->monitor), NULL, _leda_pool_monitor_routine, NULL))
         {
-            pthread_mutex_unlock (&(pool->queue_lock));
-            log_w(LEDA_TAG_NAME, "thread 0x%x will exit\n", pthread_self());
-            pthread_exit (NULL);
+            pool->monitor_running = 1;
+        }
+        else
+        {
+            log_w(LEDA_TAG_NAME, "create thread pool monitor failed\n");
         }
+    }
 
-        log_d(LEDA_TAG_NAME, "thread 0x%x is starting to work\n", pthread_self());
-        assert (pool->cur_queue_size != 0);
-        assert (pool->queue_head != NULL);
-        
-        /* 等待队列长度减去1，并取出链表中的头元素 */
-        CThread_worker *worker = pool->queue_head;
-        pool->queue_head = worker->next;
-        pool->cur_queue_size--;
+    log_d(LEDA_TAG_NAME, "thread pool mode: %d, threads: %d-%d, queues: %d\n", 
+                         pool->mode, pool->min_thread_num, pool->max_thread_num, pool->queue_nums);
 
-        /* 调用回调函数，执行任务 */
-        pthread_mutex_unlock(&(pool->queue_lock));
-        (*(worker->process))(worker->arg);
-        free(worker);
-        worker = NULL;
+    return LE_SUCCESS;
+}
+
+int leda_pool_add_worker (void *(*process)(void *arg), void *arg)
+{
+    CThread_task_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.priority = LEDA_POOL_PRIO_SET;
+
+    return leda_pool_add_task(&attr, process, arg);
+}
+
+/*
+ * 提交串行任务, 相同key的任务严格按提交顺序执行且同一时刻只在一个线程上执行,
+ * 不同key的任务在线程池中并行执行.
+ */
+int leda_pool_add_keyed_worker(unsigned int key, void *(*process)(void *arg), void *arg)
+{
+    CThread_task_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.priority = LEDA_POOL_PRIO_SET;
+    attr.keyed    = 1;
+    attr.key      = key;
+
+    return leda_pool_add_task(&attr, process, arg);
+}
+
+/* 
+ * 任务准入检查: 排队任务数达到上限时拒绝, 达到高水位时通知驱动
+ * 注: 控制类任务不受上限约束, 也不计入排队任务数
+ */
+static int _leda_pool_admit(int priority)
+{
+    int pending = 0;
+
+    if (LEDA_POOL_PRIO_CONTROL == priority)
+    {
+        return LE_SUCCESS;
+    }
+
+    pending = __sync_add_and_fetch(&(pool->pending), 1);
+    if ((pool->max_pending > 0) && (pending > pool->max_pending))
+    {
+        (void)__sync_sub_and_fetch(&(pool->pending), 1);
+        (void)__sync_add_and_fetch(&(pool->rejects), 1);
+        log_w(LEDA_TAG_NAME, "thread pool queue is full, pending: %d\n", pending - 1);
+        return LE_ERROR_SERVICE_UNREACHABLE;
+    }
+
+    if ((pool->high_watermark > 0) 
+        && (pending >= pool->high_watermark) 
+        && (__sync_bool_compare_and_swap(&(pool->watermark_high), 0, 1)))
+    {
+        log_w(LEDA_TAG_NAME, "thread pool queue reach high watermark, pending: %d\n", pending);
+        if (NULL != pool->watermark_cb)
+        {
+            pool->watermark_cb(1, pending);
+        }
+    }
+
+    return LE_SUCCESS;
+}
+
+/* 任务开始执行或被丢弃, 排队任务数回落到低水位时通知驱动 */
+static void _leda_pool_release(int priority)
+{
+    int pending = 0;
+
+    if (LEDA_POOL_PRIO_CONTROL == priority)
+    {
+        return;
+    }
+
+    pending = __sync_sub_and_fetch(&(pool->pending), 1);
+    if ((pool->watermark_high) 
+        && (pending <= pool->low_watermark) 
+        && (__sync_bool_compare_and_swap(&(pool->watermark_high), 1, 0)))
+    {
+        log_i(LEDA_TAG_NAME, "thread pool queue fall to low watermark, pending: %d\n", pending);
+        if (NULL != pool->watermark_cb)
+        {
+            pool->watermark_cb(0, pending);
+        }
+    }
+}
+
+/* 提交无序任务, 轮询投递到各队列 */
+static int _leda_pool_add_unkeyed(CThread_worker *task)
+{
+    CThread_queue   *queue      = NULL;
+    CThread_worker  *newworker  = NULL;
+    int             flags       = 0;
+
+    queue = &(pool->queues[__sync_fetch_and_add(&(pool->next_queue), 1) % pool->queue_nums]);
+
+    pthread_mutex_lock(&(queue->queue_lock));
+    newworker = _leda_pool_alloc_worker(queue);
+    if (NULL == newworker)
+    {
+        pthread_mutex_unlock(&(queue->queue_lock));
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    *newworker = *task;
+    flags = _leda_pool_submit_ready(queue, newworker);
+    pthread_mutex_unlock(&(queue->queue_lock));
+
+    _leda_pool_kick(queue, flags);
+
+    return LE_SUCCESS;
+}
+
+/* 提交串行任务, 该key已有任务在执行时排在通道内等待 */
+static int _leda_pool_add_keyed(unsigned int key, CThread_worker *task)
+{
+    CThread_bucket  *bucket     = &(pool->buckets[key % TRPOOL_LANE_BUCKET_NUM]);
+    CThread_queue   *queue      = _leda_pool_keyed_queue(key);
+    CThread_worker  *newworker  = NULL;
+    CThread_lane    *lane       = NULL;
+    int             flags       = 0;
+
+    /* 加锁顺序: lane_lock -> queue_lock */
+    pthread_mutex_lock(&(bucket->lane_lock));
+    pthread_mutex_lock(&(queue->queue_lock));
+    newworker = _leda_pool_alloc_worker(queue);
+    if (NULL == newworker)
+    {
+        pthread_mutex_unlock(&(queue->queue_lock));
+        pthread_mutex_unlock(&(bucket->lane_lock));
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    *newworker      = *task;
+    newworker->key  = key;
+    newworker->next = NULL;
+
+    lane = _leda_pool_find_lane(bucket, key);
+    if (NULL != lane)
+    {
+        pthread_mutex_unlock(&(queue->queue_lock));
+
+        newworker->lane = lane;
+        if (NULL != lane->tail)
+        {
+            lane->tail->next = newworker;
+        }
+        else
+        {
+            lane->head = newworker;
+        }
+        lane->tail = newworker;
+        pthread_mutex_unlock(&(bucket->lane_lock));
+
+        return LE_SUCCESS;
+    }
+
+    lane = _leda_pool_new_lane(bucket, key);
+    if (NULL == lane)
+    {
+        _leda_pool_free_worker(queue, newworker);
+        pthread_mutex_unlock(&(queue->queue_lock));
+        pthread_mutex_unlock(&(bucket->lane_lock));
+        log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    newworker->lane = lane;
+    flags = _leda_pool_submit_ready(queue, newworker);
+    pthread_mutex_unlock(&(queue->queue_lock));
+    pthread_mutex_unlock(&(bucket->lane_lock));
+
+    _leda_pool_kick(queue, flags);
+
+    return LE_SUCCESS;
+}
+
+/*
+ * 按属性提交任务.
+ *
+ * attr:    任务属性, 指定优先级, 是否串行及排队超时时间.
+ * process: 任务回调.
+ * arg:     任务回调参数.
+ *
+ * 注: 串行通道内的任务不区分优先级, 严格按提交顺序执行; 优先级只作用于不同通道及无序任务之间.
+ *     任务在通道或就绪队列中等待超过timeout_ms后, 不再执行process, 改为调用discard(arg, LE_ERROR_TIMEOUT).
+ *     线程池销毁排空期间拒绝新任务, 返回LE_ERROR_SERVICE_UNREACHABLE.
+ *
+ * 成功返回LE_SUCCESS, 失败返回错误码.
+ */
+int leda_pool_add_task(const CThread_task_attr *attr, void *(*process)(void *arg), void *arg)
+{
+    CThread_worker  task;
+    int             ret = LE_SUCCESS;
+
+    if ((NULL == pool) 
+        || (NULL == attr) 
+        || (NULL == process)
+        || (attr->priority < LEDA_POOL_PRIO_CONTROL) 
+        || (attr->priority >= LEDA_POOL_PRIO_BUTT)
+        || ((attr->timeout_ms > 0) && (NULL == attr->discard)))
+    {
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if (*(volatile int *)&(pool->draining))
+    {
+        return LE_ERROR_SERVICE_UNREACHABLE;
+    }
+
+    memset(&task, 0, sizeof(task));
+    task.process    = process;
+    task.arg        = arg;
+    task.discard    = attr->discard;
+    task.priority   = attr->priority;
+    task.submit     = _leda_pool_now_us();
+    task.deadline   = (attr->timeout_ms > 0) ? (_leda_pool_now_ms() + attr->timeout_ms) : 0;
+
+    ret = _leda_pool_admit(attr->priority);
+    if (LE_SUCCESS != ret)
+    {
+        return ret;
+    }
+
+    ret = (attr->keyed) ? _leda_pool_add_keyed(attr->key, &task) : _leda_pool_add_unkeyed(&task);
+    if (LE_SUCCESS != ret)
+    {
+        _leda_pool_release(task.priority);
+    }
+
+    return ret;
+}
+
+/*
+ * 初始化批量提交缓存.
+ */
+void leda_pool_batch_init(CThread_batch *batch)
+{
+    batch->count = 0;
+}
+
+/*
+ * 向批量提交缓存追加任务, 缓存满时先提交缓存中已有的任务.
+ *
+ * 注: 批量提交的任务必须设置discard, 提交失败的任务在leda_pool_batch_commit中通过discard(arg, 错误码)交还提交者.
+ *
+ * 成功返回LE_SUCCESS, 参数错误返回LE_ERROR_INVAILD_PARAM, 此时任务未加入缓存.
+ */
+int leda_pool_batch_add(CThread_batch *batch, const CThread_task_attr *attr, void *(*process)(void *arg), void *arg)
+{
+    CThread_batch_task *item = NULL;
+
+    if ((NULL == batch) 
+        || (NULL == attr) 
+        || (NULL == process)
+        || (NULL == attr->discard)
+        || (attr->priority < LEDA_POOL_PRIO_CONTROL) 
+        || (attr->priority >= LEDA_POOL_PRIO_BUTT))
+    {
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if (batch->count >= LEDA_POOL_BATCH_NUM)
+    {
+        (void)leda_pool_batch_commit(batch);
+    }
+
+    item            = &(batch->tasks[batch->count++]);
+    item->attr      = *attr;
+    item->process   = process;
+    item->arg       = arg;
+
+    return LE_SUCCESS;
+}
+
+/*
+ * 提交批量缓存中的所有任务并清空缓存.
+ *
+ * 每个就绪队列只加锁一次, 并按新增的就绪任务数唤醒等待线程; 串行任务仍按追加顺序进入各自的通道.
+ * 排空期间, 队列满或内存不足而未能提交的任务, 在释放所有锁后通过discard交还提交者.
+ *
+ * 返回成功提交的任务数.
+ */
+int leda_pool_batch_commit(CThread_batch *batch)
+{
+    CThread_worker      *workers[LEDA_POOL_BATCH_NUM];
+    CThread_queue       *targets[LEDA_POOL_BATCH_NUM];  /* 各任务投递的就绪队列 */
+    int                 results[LEDA_POOL_BATCH_NUM];
+    int                 ready[LEDA_POOL_BATCH_NUM];     /* 是否待放入就绪队列 */
+    CThread_batch_task  *item       = NULL;
+    CThread_bucket      *bucket     = NULL;
+    CThread_lane        *lane       = NULL;
+    CThread_queue       *queue      = NULL;
+    uint64_t            now         = 0;
+    unsigned int        next        = 0;
+    int                 unkeyed     = 0;
+    int                 count       = 0;
+    int                 pushed      = 0;
+    int                 submitted   = 0;
+    int                 flags       = 0;
+    int                 i           = 0;
+    int                 j           = 0;
+
+    if ((NULL == batch) || (0 == batch->count))
+    {
+        return 0;
+    }
+
+    count           = batch->count;
+    batch->count    = 0;
+
+    if ((NULL == pool) || (*(volatile int *)&(pool->draining)))
+    {
+        for (i = 0; i < count; i++)
+        {
+            batch->tasks[i].attr.discard(batch->tasks[i].arg, LE_ERROR_SERVICE_UNREACHABLE);
+        }
+        return 0;
+    }
+
+    /* 准入检查, 确定各任务投递的队列 */
+    for (i = 0; i < count; i++)
+    {
+        item        = &(batch->tasks[i]);
+        workers[i]  = NULL;
+        ready[i]    = 0;
+        results[i]  = _leda_pool_admit(item->attr.priority);
+        if (LE_SUCCESS != results[i])
+        {
+            continue;
+        }
+
+        if (item->attr.keyed)
+        {
+            targets[i] = _leda_pool_keyed_queue(item->attr.key);
+        }
+        else
+        {
+            targets[i] = NULL;
+            unkeyed++;
+        }
+    }
+
+    next = __sync_fetch_and_add(&(pool->next_queue), unkeyed);
+    for (i = 0; i < count; i++)
+    {
+        if ((LE_SUCCESS == results[i]) && (NULL == targets[i]))
+        {
+            targets[i] = &(pool->queues[next++ % pool->queue_nums]);
+        }
+    }
+
+    /* 每个队列加锁一次, 为投递到该队列的任务分配任务槽 */
+    now = _leda_pool_now_us();
+    for (i = 0; i < count; i++)
+    {
+        if ((LE_SUCCESS != results[i]) || (NULL != workers[i]))
+        {
+            continue;
+        }
+
+        queue = targets[i];
+        pthread_mutex_lock(&(queue->queue_lock));
+        for (j = i; j < count; j++)
+        {
+            if ((LE_SUCCESS != results[j]) || (queue != targets[j]))
+            {
+                continue;
+            }
+
+            item        = &(batch->tasks[j]);
+            workers[j]  = _leda_pool_alloc_worker(queue);
+            if (NULL == workers[j])
+            {
+                results[j] = LE_ERROR_ALLOCATING_MEM;
+                continue;
+            }
+
+            memset(workers[j], 0, sizeof(CThread_worker));
+            workers[j]->process     = item->process;
+            workers[j]->arg         = item->arg;
+            workers[j]->discard     = item->attr.discard;
+            workers[j]->priority    = item->attr.priority;
+            workers[j]->key         = item->attr.key;
+            workers[j]->submit      = now;
+            workers[j]->deadline    = (item->attr.timeout_ms > 0) ? (now / 1000 + item->attr.timeout_ms) : 0;
+        }
+        pthread_mutex_unlock(&(queue->queue_lock));
+    }
+
+    /* 串行任务按追加顺序进入通道, 只有通道空闲时才放入就绪队列 */
+    for (i = 0; i < count; i++)
+    {
+        if (LE_SUCCESS != results[i])
+        {
+            continue;
+        }
+
+        item = &(batch->tasks[i]);
+        if (!item->attr.keyed)
+        {
+            ready[i] = 1;
+            continue;
+        }
+
+        bucket = &(pool->buckets[item->attr.key % TRPOOL_LANE_BUCKET_NUM]);
+        pthread_mutex_lock(&(bucket->lane_lock));
+        lane = _leda_pool_find_lane(bucket, item->attr.key);
+        if (NULL != lane)
+        {
+            workers[i]->lane = lane;
+            if (NULL != lane->tail)
+            {
+                lane->tail->next = workers[i];
+            }
+            else
+            {
+                lane->head = workers[i];
+            }
+            lane->tail = workers[i];
+        }
+        else
+        {
+            lane = _leda_pool_new_lane(bucket, item->attr.key);
+            if (NULL != lane)
+            {
+                workers[i]->lane    = lane;
+                ready[i]            = 1;
+            }
+            else
+            {
+                results[i] = LE_ERROR_ALLOCATING_MEM;
+            }
+        }
+        pthread_mutex_unlock(&(bucket->lane_lock));
+    }
+
+    /* 每个队列加锁一次放入就绪任务, 按新增任务数唤醒等待线程 */
+    for (i = 0; i < count; i++)
+    {
+        if (!ready[i])
+        {
+            continue;
+        }
+
+        queue   = targets[i];
+        pushed  = 0;
+        pthread_mutex_lock(&(queue->queue_lock));
+        for (j = i; j < count; j++)
+        {
+            if ((ready[j]) && (queue == targets[j]))
+            {
+                _leda_pool_push_ready(queue, workers[j]);
+                ready[j] = 0;
+                pushed++;
+            }
+        }
+        flags = _leda_pool_signal_ready(queue, pushed);
+        pthread_mutex_unlock(&(queue->queue_lock));
+
+        _leda_pool_kick(queue, flags);
+    }
+
+    /* 
+     * 未能提交的任务在锁外交还提交者
+     * 注: LE_ERROR_ALLOCATING_MEM的任务已通过准入检查, 需回退排队计数
+     */
+    for (i = 0; i < count; i++)
+    {
+        item = &(batch->tasks[i]);
+        if (LE_SUCCESS == results[i])
+        {
+            submitted++;
+            continue;
+        }
+
+        if (LE_ERROR_ALLOCATING_MEM == results[i])
+        {
+            if (NULL != workers[i])
+            {
+                pthread_mutex_lock(&(targets[i]->queue_lock));
+                _leda_pool_free_worker(targets[i], workers[i]);
+                pthread_mutex_unlock(&(targets[i]->queue_lock));
+            }
+            _leda_pool_release(item->attr.priority);
+            log_w(LEDA_TAG_NAME, "no memory can allocate\n");
+        }
+
+        item->attr.discard(item->arg, results[i]);
+    }
+
+    return submitted;
+}
+
+/*
+ * 判断调用者是否为线程池工作线程.
+ *
+ * 是返回1, 否则返回0. 工作线程中不能阻塞等待需要线程池执行才能完成的任务, 否则线程耗尽时会死锁.
+ */
+int leda_pool_in_worker(void)
+{
+    return g_pool_worker;
+}
+
+/*
+ * 判断串行任务能否在调用者线程中直接执行.
+ *
+ * batch:   调用者尚未提交的批量缓存, 可为NULL.
+ * key:     串行任务key.
+ *
+ * 线程池未排空, 且该key在线程池中没有排队或执行中的任务, 在batch中也没有待提交的任务时返回1, 否则返回0.
+ * 注: 调用者需保证检查后不会有其他线程提交该key的任务, 如同一设备的请求只由一个分发线程提交.
+ */
+int leda_pool_can_run_inline(const CThread_batch *batch, unsigned int key)
+{
+    CThread_bucket  *bucket = NULL;
+    CThread_lane    *lane   = NULL;
+    int             i       = 0;
+
+    if ((NULL == pool) || (*(volatile int *)&(pool->draining)))
+    {
+        return 0;
+    }
+
+    for (i = 0; (NULL != batch) && (i < batch->count); i++)
+    {
+        if ((batch->tasks[i].attr.keyed) && (key == batch->tasks[i].attr.key))
+        {
+            return 0;
+        }
+    }
+
+    bucket = &(pool->buckets[key % TRPOOL_LANE_BUCKET_NUM]);
+    pthread_mutex_lock(&(bucket->lane_lock));
+    lane = _leda_pool_find_lane(bucket, key);
+    pthread_mutex_unlock(&(bucket->lane_lock));
+
+    return (NULL == lane);
+}
+
+/*
+ * 在调用者线程中直接执行任务, 执行时间计入对应优先级的统计, 排队时间记为0.
+ */
+void leda_pool_run_inline(int priority, void *(*process)(void *arg), void *arg)
+{
+    uint64_t start = _leda_pool_now_us();
+
+    (*process)(arg);
+
+    if ((NULL != pool) && (priority >= LEDA_POOL_PRIO_CONTROL) && (priority < LEDA_POOL_PRIO_BUTT))
+    {
+        _leda_pool_histogram_add(priority, &(pool->queue_wait[priority]), 0);
+        _leda_pool_histogram_add(priority, &(pool->run_time[priority]), _leda_pool_now_us() - start);
+    }
+}
+
+/*
+ * 申请请求内存, 请求在线程池中处理完毕后通过leda_pool_free_request归还.
+ *
+ * size: 请求内存大小, 不超过TRPOOL_REQUEST_SIZE时从预分配内存块分配, 否则或内存块用完时动态分配.
+ *
+ * 成功返回内存地址, 失败返回NULL.
+ */
+void *leda_pool_alloc_request(size_t size)
+{
+    CThread_request_block *block = NULL;
+
+    if ((NULL != pool) && (size <= TRPOOL_REQUEST_SIZE))
+    {
+        pthread_mutex_lock(&(pool->request_lock));
+        block = pool->free_requests;
+        if (NULL != block)
+        {
+            pool->free_requests = block->next;
+            pool->request_hits++;
+            pthread_mutex_unlock(&(pool->request_lock));
+            return (void *)block;
+        }
+        pthread_mutex_unlock(&(pool->request_lock));
+    }
+
+    if (NULL != pool)
+    {
+        (void)__sync_fetch_and_add(&(pool->request_fallbacks), 1);
+    }
+
+    return malloc(size);
+}
+
+/* 归还请求内存, 非预分配的请求直接释放 */
+void leda_pool_free_request(void *request)
+{
+    CThread_request_block *block = (CThread_request_block *)request;
+
+    if ((NULL != pool) 
+        && ((char *)request >= pool->requests) 
+        && ((char *)request < (pool->requests + TRPOOL_REQUEST_NUM * TRPOOL_REQUEST_SIZE)))
+    {
+        pthread_mutex_lock(&(pool->request_lock));
+        block->next         = pool->free_requests;
+        pool->free_requests = block;
+        pthread_mutex_unlock(&(pool->request_lock));
+        return;
+    }
+
+    free(request);
+}
+
+/* 获取线程池统计信息, 各优先级直方图在锁内整体拷贝 */
+int leda_pool_get_stats(leda_pool_stats_t *stats)
+{
+    int                 i = 0;
+    CThread_alloc_stats alloc_stats;
+
+    if (NULL == pool)
+    {
+        return LE_ERROR_UNKNOWN;
+    }
+
+    memset(stats, 0, sizeof(leda_pool_stats_t));
+    for (i = 0; (i < LEDA_OP_BUTT) && (i < LEDA_POOL_PRIO_BUTT); i++)
+    {
+        pthread_mutex_lock(&(pool->histogram_lock[i]));
+        stats->queue_wait[i]    = pool->queue_wait[i];
+        stats->run_time[i]      = pool->run_time[i];
+        pthread_mutex_unlock(&(pool->histogram_lock[i]));
+        stats->discards[i]      = pool->discards[i];
+    }
+
+    leda_pool_get_alloc_stats(&alloc_stats);
+    stats->rejects              = alloc_stats.rejects;
+    stats->slot_hits            = alloc_stats.slot_hits;
+    stats->slot_fallbacks       = alloc_stats.slot_fallbacks;
+    stats->request_hits         = alloc_stats.request_hits;
+    stats->request_fallbacks    = alloc_stats.request_fallbacks;
+    stats->queue_size           = *(volatile int *)&(pool->pending);
+
+    pthread_mutex_lock(&(pool->thread_lock));
+    stats->thread_nums          = pool->cur_thread_num;
+    pthread_mutex_unlock(&(pool->thread_lock));
+
+    return LE_SUCCESS;
+}
+
+/* 获取任务槽和请求内存块的分配统计 */
+void leda_pool_get_alloc_stats(CThread_alloc_stats *stats)
+{
+    int i = 0;
+
+    memset(stats, 0, sizeof(CThread_alloc_stats));
+    if (NULL == pool)
+    {
+        return;
+    }
+
+    for (i = 0; i < pool->queue_nums; i++)
+    {
+        pthread_mutex_lock(&(pool->queues[i].queue_lock));
+        stats->slot_hits        += pool->queues[i].slot_hits;
+        stats->slot_fallbacks   += pool->queues[i].slot_fallbacks;
+        pthread_mutex_unlock(&(pool->queues[i].queue_lock));
+    }
+
+    pthread_mutex_lock(&(pool->request_lock));
+    stats->request_hits         = pool->request_hits;
+    stats->request_fallbacks    = pool->request_fallbacks;
+    pthread_mutex_unlock(&(pool->request_lock));
+
+    stats->rejects = *(volatile unsigned long *)&(pool->rejects);
+}
+
+/* 丢弃未执行的任务, 由提交者通过discard回调应答请求并释放参数 */
+static void _leda_pool_discard(const CThread_worker *task, int reason)
+{
+    log_w(LEDA_TAG_NAME, "task discarded, priority: %d, reason: %d\n", task->priority, reason);
+    (void)__sync_fetch_and_add(&(pool->discards[task->priority]), 1);
+    (*(task->discard))(task->arg, reason);
+}
+
+/* 
+ * 排空超时后, 将串行通道和就绪队列中所有剩余任务快速失败, 返回处理的任务数
+ * 注: 未设置discard回调的任务无法代为应答, 直接在当前线程执行
+ */
+static int _leda_pool_fail_pending(int reason)
+{
+    int             i       = 0;
+    int             count   = 0;
+    CThread_list    waiting = {NULL, NULL};
+    CThread_lane    *lane   = NULL;
+    CThread_queue   *queue  = NULL;
+    CThread_worker  *worker = NULL;
+    CThread_worker  task;
+
+    /* 先摘下通道内排队的后续任务, 之后通道当前任务结束时不会再投递新任务 */
+    for (i = 0; i < TRPOOL_LANE_BUCKET_NUM; i++)
+    {
+        pthread_mutex_lock(&(pool->buckets[i].lane_lock));
+        for (lane = pool->buckets[i].lanes; NULL != lane; lane = lane->next)
+        {
+            if (NULL == lane->head)
+            {
+                continue;
+            }
+
+            if (NULL != waiting.tail)
+            {
+                waiting.tail->next = lane->head;
+            }
+            else
+            {
+                waiting.head = lane->head;
+            }
+            waiting.tail = lane->tail;
+            lane->head   = NULL;
+            lane->tail   = NULL;
+        }
+        pthread_mutex_unlock(&(pool->buckets[i].lane_lock));
+    }
+
+    while (NULL != (worker = waiting.head))
+    {
+        waiting.head = worker->next;
+        /* 通道可能已回收并被其他key复用, 不能在lane_lock外访问worker->lane */
+        queue = _leda_pool_keyed_queue(worker->key);
+
+        pthread_mutex_lock(&(queue->queue_lock));
+        task = *worker;
+        _leda_pool_free_worker(queue, worker);
+        pthread_mutex_unlock(&(queue->queue_lock));
+
+        _leda_pool_release(task.priority);
+        if (NULL != task.discard)
+        {
+            _leda_pool_discard(&task, reason);
+        }
+        else
+        {
+            (*(task.process))(task.arg);
+        }
+        count++;
+    }
+
+    /* 再清空就绪队列, 串行任务需结束所在通道 */
+    for (i = 0; i < pool->queue_nums; i++)
+    {
+        queue = &(pool->queues[i]);
+        while (1)
+        {
+            pthread_mutex_lock(&(queue->queue_lock));
+            worker = _leda_pool_pop_ready(queue);
+            if (NULL == worker)
+            {
+                pthread_mutex_unlock(&(queue->queue_lock));
+                break;
+            }
+            task = *worker;
+            _leda_pool_free_worker(queue, worker);
+            pthread_mutex_unlock(&(queue->queue_lock));
+
+            _leda_pool_release(task.priority);
+            if (NULL != task.discard)
+            {
+                _leda_pool_discard(&task, reason);
+            }
+            else
+            {
+                (*(task.process))(task.arg);
+            }
+
+            if (NULL != task.lane)
+            {
+                _leda_pool_finish_lane(task.lane);
+            }
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* 等待所有工作线程退出, 超过deadline(单调时钟毫秒)仍有线程未退出返回LE_ERROR_TIMEOUT */
+static int _leda_pool_wait_threads(uint64_t deadline)
+{
+    int             ret = LE_SUCCESS;
+    struct timespec tout;
+
+    tout.tv_sec  = (time_t)(deadline / 1000);
+    tout.tv_nsec = (long)(deadline % 1000) * 1000000;
+
+    pthread_mutex_lock(&(pool->thread_lock));
+    while (pool->cur_thread_num > 0)
+    {
+        if (ETIMEDOUT == pthread_cond_timedwait(&(pool->thread_exit), &(pool->thread_lock), &tout))
+        {
+            ret = (pool->cur_thread_num > 0) ? LE_ERROR_TIMEOUT : LE_SUCCESS;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&(pool->thread_lock));
+
+    return ret;
+}
+
+/*
+ * 排空线程池.
+ *
+ * 不再接收新任务, 已提交的任务继续执行, 线程取不到任务后退出;
+ * 超过drain_timeout_ms仍未执行的任务以LE_ERROR_SERVICE_UNREACHABLE丢弃, 再等待执行中的任务最多TRPOOL_EXIT_GRACE_MS.
+ * 排空期间消息分发线程应继续运行, 以便任务中发出的同步调用能收到应答.
+ *
+ * 成功返回LE_SUCCESS; 仍有任务阻塞在回调中时返回LE_ERROR_TIMEOUT.
+ */
+int leda_pool_drain(void)
+{
+    int i       = 0;
+    int count   = 0;
+
+    if ((NULL == pool) || (pool->draining))
+    {
+        return LE_ERROR_UNKNOWN;
+    }
+
+    /* 唤醒所有等待线程, 线程池开始排空; 在queue_lock内广播, 线程休眠前检查draining, 不会丢失唤醒 */
+    pool->drain_deadline = _leda_pool_now_ms() + pool->drain_timeout_ms;
+    for (i = 0; i < pool->queue_nums; i++)
+    {
+        pthread_mutex_lock(&(pool->queues[i].queue_lock));
+        pool->draining = 1;
+        pthread_cond_broadcast(&(pool->queues[i].queue_ready));
+        pthread_mutex_unlock(&(pool->queues[i].queue_lock));
+    }
+    _leda_pool_stop_monitor();
+
+    /* 阻塞等待线程退出, 线程为分离状态, 通过计数确认全部退出 */
+    if (LE_SUCCESS == _leda_pool_wait_threads(pool->drain_deadline))
+    {
+        return LE_SUCCESS;
+    }
+
+    count = _leda_pool_fail_pending(LE_ERROR_SERVICE_UNREACHABLE);
+    log_w(LEDA_TAG_NAME, "thread pool drain timeout, %d pending tasks failed\n", count);
+
+    for (i = 0; i < pool->queue_nums; i++)
+    {
+        pthread_mutex_lock(&(pool->queues[i].queue_lock));
+        pool->shutdown = 1;
+        pthread_cond_broadcast(&(pool->queues[i].queue_ready));
+        pthread_mutex_unlock(&(pool->queues[i].queue_lock));
+    }
+
+    return _leda_pool_wait_threads(_leda_pool_now_ms() + TRPOOL_EXIT_GRACE_MS);
+}
+
+/*
+ * 销毁线程池, 未排空时先排空.
+ *
+ * 调用前需停止所有任务提交者. 成功返回LE_SUCCESS; 仍有任务阻塞在回调中时返回LE_ERROR_TIMEOUT, 此时线程池不释放.
+ */
+int leda_pool_destroy(void)
+{
+    CThread_alloc_stats stats;
+    int                 busy = 0;
+
+    if (NULL == pool)
+    {
+        return LE_ERROR_UNKNOWN;
+    }
+
+    if (!pool->draining)
+    {
+        (void)leda_pool_drain();
+    }
+
+    pthread_mutex_lock(&(pool->thread_lock));
+    busy = pool->cur_thread_num;
+    pthread_mutex_unlock(&(pool->thread_lock));
+    if (busy > 0)
+    {
+        log_w(LEDA_TAG_NAME, "thread pool still has %d busy threads, leave it\n", busy);
+        return LE_ERROR_TIMEOUT;
+    }
+
+    /* 线程全部退出后, 排空期间并发提交的任务同样应答后再释放 */
+    (void)_leda_pool_fail_pending(LE_ERROR_SERVICE_UNREACHABLE);
+
+    leda_pool_get_alloc_stats(&stats);
+    log_i(LEDA_TAG_NAME, "thread pool alloc stats, slot hits: %lu, slot fallbacks: %lu, request hits: %lu, request fallbacks: %lu, rejects: %lu\n",
+                         stats.slot_hits, stats.slot_fallbacks, stats.request_hits, stats.request_fallbacks, stats.rejects);
+
+    /* 销毁等待队列, 串行通道, 条件变量和互斥量 */
+    _leda_pool_free();
+
+    return LE_SUCCESS;
+}
+
+/*
+ * 设置当前线程的CPU亲和性, 调度策略和nice值, 失败时只打印告警, 线程继续以默认调度运行.
+ *
+ * sched: 调度配置, 值为0的字段保持系统默认.
+ */
+void leda_pool_set_thread_sched(const leda_thread_sched_t *sched)
+{
+    int                 i   = 0;
+    int                 ret = 0;
+    cpu_set_t           cpu_set;
+    struct sched_param  param;
+
+    if (0 != sched->cpu_mask)
+    {
+        CPU_ZERO(&cpu_set);
+        for (i = 0; i < (int)(sizeof(sched->cpu_mask) * 8); i++)
+        {
+            if (sched->cpu_mask & (1UL << i))
+            {
+                CPU_SET(i, &cpu_set);
+            }
+        }
+
+        ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if (0 != ret)
+        {
+            log_w(LEDA_TAG_NAME, "set thread cpu mask: 0x%lx failed: %s\n", sched->cpu_mask, strerror(ret));
+        }
+    }
+
+    if (SCHED_OTHER != sched->sched_policy)
+    {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = sched->sched_priority;
+        ret = pthread_setschedparam(pthread_self(), sched->sched_policy, &param);
+        if (0 != ret)
+        {
+            log_w(LEDA_TAG_NAME, "set thread sched policy: %d, priority: %d failed: %s\n", 
+                                 sched->sched_policy, sched->sched_priority, strerror(ret));
+        }
+    }
+    else if (0 != sched->nice)
+    {
+        /* linux下nice值是线程级的, 以线程id设置只影响当前线程 */
+        if (0 != setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), sched->nice))
+        {
+            log_w(LEDA_TAG_NAME, "set thread nice: %d failed: %s\n", sched->nice, strerror(errno));
+        }
+    }
+}
+
+/* 在队列上等待空闲超时时间; 调用者需持有queue_lock */
+static int _leda_pool_timedwait(CThread_queue *queue, struct timespec *tout)
+{
+    clock_gettime(CLOCK_MONOTONIC, tout);
+    tout->tv_sec  += pool->idle_timeout_ms / 1000;
+    tout->tv_nsec += (long)(pool->idle_timeout_ms % 1000) * 1000000;
+    if (tout->tv_nsec >= 1000000000)
+    {
+        tout->tv_sec++;
+        tout->tv_nsec -= 1000000000;
+    }
+
+    return pthread_cond_timedwait(&(queue->queue_ready), &(queue->queue_lock), tout);
+}
+
+void *leda_thread_routine(void *arg)
+{
+    int             home    = (int)(intptr_t)arg % pool->queue_nums;
+    CThread_queue   *queue  = &(pool->queues[home]);
+    CThread_worker  task;
+    unsigned int    epoch   = 0;
+    int             retire  = 0;
+    struct timespec tout;
+    char            name[16];
+    uint64_t        start   = 0;
+
+    /* 线程命名为leda_worker_N, 便于在top/perf中区分 */
+    snprintf(name, sizeof(name), "leda_worker_%u", __sync_fetch_and_add(&(pool->thread_seq), 1));
+    prctl(PR_SET_NAME, name);
+    leda_pool_set_thread_sched(&(pool->sched));
+    g_pool_worker = 1;
+
+    log_i(LEDA_TAG_NAME, "starting thread 0x%x\n", pthread_self());
+
+    while (1)
+    {
+        /* 线程池要销毁了 */
+        if (*(volatile int *)&(pool->shutdown))
+        {
+            break;
+        }
+
+        epoch = *(volatile unsigned int *)&(pool->epoch);
+        __sync_synchronize();
+        if (_leda_pool_take_worker(home, &task))
+        {
+            _leda_pool_release(task.priority);
+
+            start = _leda_pool_now_us();
+            _leda_pool_histogram_add(task.priority, &(pool->queue_wait[task.priority]), start - task.submit);
+
+            /* 任务排队过久且仍有积压时扩容, 避免后续任务继续等待 */
+            if (_leda_pool_is_elastic() 
+                && ((start - task.enqueue) >= (uint64_t)pool->spawn_wait_ms * 1000)
+                && (0 != *(volatile int *)&(queue->cur_queue_size))
+                && (0 == *(volatile int *)&(queue->waiting)))
+            {
+                _leda_pool_spawn(home);
+            }
+
+            log_d(LEDA_TAG_NAME, "thread 0x%x is starting to work\n", pthread_self());
+
+            /* 排队超时的任务不再执行, 由提交者应答超时; 排空超时后剩余任务快速失败 */
+            if ((0 != task.deadline) && ((start / 1000) >= task.deadline))
+            {
+                _leda_pool_discard(&task, LE_ERROR_TIMEOUT);
+            }
+            else if ((*(volatile int *)&(pool->draining)) 
+                     && ((start / 1000) >= pool->drain_deadline) 
+                     && (NULL != task.discard))
+            {
+                _leda_pool_discard(&task, LE_ERROR_SERVICE_UNREACHABLE);
+            }
+            else
+            {
+                /* 调用回调函数，执行任务 */
+                (*(task.process))(task.arg);
+                _leda_pool_histogram_add(task.priority, &(pool->run_time[task.priority]), _leda_pool_now_us() - start);
+            }
+
+            /* 串行任务执行完毕, 释放通道中的下一个任务 */
+            if (NULL != task.lane)
+            {
+                _leda_pool_finish_lane(task.lane);
+            }
+            continue;
+        }
+
+        /* 排空中且已无可取任务, 通道内的后续任务由执行当前任务的线程接着处理 */
+        if (*(volatile int *)&(pool->draining))
+        {
+            break;
+        }
+
+        /*  所有队列为空并且不销毁线程池，则在本线程队列上阻塞;
+            置waiting后重新检查epoch, 期间若有任务投递到其他队列则不休眠直接再次窃取 */
+        pthread_mutex_lock(&(queue->queue_lock));
+        queue->waiting++;
+        __sync_synchronize();
+        if ((0 == queue->cur_queue_size) 
+            && (!pool->shutdown) 
+            && (!pool->draining) 
+            && (epoch == *(volatile unsigned int *)&(pool->epoch)))
+        {
+            log_d(LEDA_TAG_NAME, "thread 0x%x is waiting\n", pthread_self());
+            if (!_leda_pool_is_elastic())
+            {
+                pthread_cond_wait(&(queue->queue_ready), &(queue->queue_lock));
+            }
+            else if ((ETIMEDOUT == _leda_pool_timedwait(queue, &tout)) && (0 == queue->cur_queue_size))
+            {
+                /* 空闲超时, 线程数多于下限时退出 */
+                pthread_mutex_lock(&(pool->thread_lock));
+                if (pool->cur_thread_num > pool->min_thread_num)
+                {
+                    pool->cur_thread_num--;
+                    pthread_cond_broadcast(&(pool->thread_exit));
+                    retire = 1;
+                }
+                pthread_mutex_unlock(&(pool->thread_lock));
+            }
+        }
+        queue->waiting--;
+        pthread_mutex_unlock(&(queue->queue_lock));
+
+        if (retire)
+        {
+            log_i(LEDA_TAG_NAME, "thread 0x%x is idle and retire\n", pthread_self());
+            pthread_exit (NULL);
+        }
     }
 
+    log_w(LEDA_TAG_NAME, "thread 0x%x will exit\n", pthread_self());
+    pthread_mutex_lock(&(pool->thread_lock));
+    pool->cur_thread_num--;
+    pthread_cond_broadcast(&(pool->thread_exit));
+    pthread_mutex_unlock(&(pool->thread_lock));
     pthread_exit (NULL);
 
     return NULL;
@@ -24,33 +24,200 @@ extern "C"
 {
 #endif
 
+/*
+* 任务优先级, 数值越小优先级越高, 与leda_op_type_e一一对应
+* 注: 线程优先取高优先级任务, 低优先级任务连续让出TRPOOL_PRIO_STARVE_NUM次后优先执行一次, 防止饿死
+*/
+typedef enum
+{
+    LEDA_POOL_PRIO_CONTROL = 0,             /* 控制类请求, 如配置变更通知 */
+    LEDA_POOL_PRIO_GET,                     /* 属性获取 */
+    LEDA_POOL_PRIO_SET,                     /* 属性设置 */
+    LEDA_POOL_PRIO_SERVICE,                 /* 服务调用, 可能长时间执行 */
+
+    LEDA_POOL_PRIO_BUTT
+} leda_pool_prio_e;
+
+/* 
+* 任务丢弃回调, 任务排队超时等原因未执行时代替process调用, 由提交者负责应答请求并释放arg
+* reason: 丢弃原因错误码, 如LE_ERROR_TIMEOUT
+*/
+typedef void (*leda_pool_discard_callback)(void *arg, int reason);
+
+/* 任务提交属性 */
+typedef struct
+{
+    int                         priority;   /* 任务优先级, 参考leda_pool_prio_e */
+    int                         keyed;      /* 是否串行任务, 非0时相同key的任务按提交顺序串行执行 */
+    unsigned int                key;        /* 串行任务key */
+    int                         timeout_ms; /* 排队超时时间(毫秒), 超时未执行的任务调用discard丢弃, 0表示不超时 */
+    leda_pool_discard_callback  discard;    /* 任务丢弃回调, timeout_ms大于0时必须设置 */
+} CThread_task_attr;
+
+/* 批量提交的最大任务数 */
+#define LEDA_POOL_BATCH_NUM     32
+
+/* 批量提交的任务 */
+typedef struct
+{
+    CThread_task_attr           attr;
+    void                        *(*process) (void *arg);
+    void                        *arg;
+} CThread_batch_task;
+
+/*
+* 批量提交缓存
+* 注: 提交者先在本地累积任务, 再一次性投递到线程池, 每个就绪队列只加锁一次, 并按新增任务数唤醒等待线程
+*/
+typedef struct
+{
+    CThread_batch_task          tasks[LEDA_POOL_BATCH_NUM];
+    int                         count;
+} CThread_batch;
+
 /*
 * 任务结构
 * 注: 线程池里所有运行和等待的任务都是一个CThread_worker. 由于所有任务都在链表里, 所以是一个链表结构
 */
 typedef struct worker
 {
-    void            *(*process) (void *arg);/* 回调函数 */
-    void            *arg;                   /* 回调函数的参数 */
-    struct worker   *next;
+    void                        *(*process) (void *arg);/* 回调函数 */
+    void                        *arg;                   /* 回调函数的参数 */
+    leda_pool_discard_callback  discard;                /* 任务丢弃回调 */
+    uint64_t                    deadline;               /* 任务截止时间(单调时钟毫秒), 0表示不超时 */
+    uint64_t                    submit;                 /* 提交时间(单调时钟微秒) */
+    uint64_t                    enqueue;                /* 进入就绪队列时间(单调时钟微秒) */
+    int                         priority;               /* 任务优先级 */
+    unsigned int                key;                    /* 串行任务的key, 提交时记录 */
+    struct lane                 *lane;                  /* 所属串行通道, NULL表示无序任务 */
+    struct worker               *next;
 } CThread_worker;
 
-/* 线程池结构 */
+/* 任务链表 */
+typedef struct
+{
+    CThread_worker  *head;
+    CThread_worker  *tail;
+} CThread_list;
+
+/*
+* 串行通道
+* 注: 相同key的任务按提交顺序逐个执行, 同一时刻最多只有一个在就绪队列或执行中, 其余在通道内排队
+*/
+typedef struct lane
+{
+    unsigned int    key;
+    CThread_worker  *head;                  /* 通道内等待的后续任务 */
+    CThread_worker  *tail;
+    struct lane     *next;                  /* 哈希桶链表 */
+} CThread_lane;
+
+/* 串行通道哈希桶, 每个桶独立加锁 */
+typedef struct
+{
+    pthread_mutex_t lane_lock;
+    CThread_lane    *lanes;                 /* 活跃串行通道 */
+    CThread_lane    *free_lanes;            /* 空闲串行通道缓存 */
+} CThread_bucket;
+
+/*
+* 就绪任务队列
+* 注: 共享模式下所有线程共用一个队列; 窃取模式下每个线程一个队列, 自身队列为空时从其他队列窃取任务
+*/
 typedef struct
 {
     pthread_mutex_t queue_lock;
     pthread_cond_t  queue_ready;
-    CThread_worker  *queue_head;            /* 链表结构, 线程池中所有等待任务 */
+    CThread_list    ready[LEDA_POOL_PRIO_BUTT]; /* 按优先级划分的等待任务链表 */
+    CThread_worker  *free_slots;            /* 预分配任务槽空闲链表 */
+    int             cur_queue_size;         /* 当前等待队列的任务数目 */
+    int             waiting;                /* 在本队列上等待任务的线程数目 */
+    int             starve;                 /* 低优先级任务连续被让出的次数 */
+    unsigned long   slot_hits;              /* 从预分配任务槽分配的次数 */
+    unsigned long   slot_fallbacks;         /* 任务槽用完后动态分配的次数 */
+} CThread_queue;
+
+/* 请求内存块空闲链表节点, 与请求内存块共用内存 */
+typedef struct request_block
+{
+    struct request_block    *next;
+} CThread_request_block;
+
+/* 内存分配统计 */
+typedef struct
+{
+    unsigned long   slot_hits;              /* 任务从预分配任务槽分配的次数 */
+    unsigned long   slot_fallbacks;         /* 任务槽用完后动态分配的次数 */
+    unsigned long   request_hits;           /* 请求从预分配内存块分配的次数 */
+    unsigned long   request_fallbacks;      /* 请求内存块用完或请求过长时动态分配的次数 */
+    unsigned long   rejects;                /* 队列满被拒绝的任务数 */
+} CThread_alloc_stats;
+
+/* 线程池结构 */
+typedef struct
+{
+    int             mode;                   /* 调度模式, 参考leda_pool_mode_e */
+    CThread_queue   *queues;                /* 就绪任务队列 */
+    int             queue_nums;             /* 就绪任务队列数目 */
+    unsigned int    next_queue;             /* 无序任务轮询投递位置 */
+    unsigned int    epoch;                  /* 任务投递计数, 用于避免线程休眠时丢失唤醒 */
+    CThread_bucket  *buckets;               /* 串行通道哈希表 */
+    CThread_worker  *slots;                 /* 预分配任务槽, 用完后退化为动态分配 */
+    int             slot_nums;              /* 预分配任务槽数目 */
+    pthread_mutex_t request_lock;
+    char            *requests;              /* 预分配请求内存块, 用完后退化为动态分配 */
+    CThread_request_block *free_requests;   /* 请求内存块空闲链表 */
+    unsigned long   request_hits;           /* 从预分配请求内存块分配的次数 */
+    unsigned long   request_fallbacks;      /* 动态分配请求内存的次数 */
+    int             pending;                /* 已提交未开始执行的任务数, 包括在串行通道内等待的任务 */
+    int             max_pending;            /* 排队任务数上限, 0表示不限制 */
+    int             high_watermark;         /* 排队任务数高水位, 0表示不检测 */
+    int             low_watermark;          /* 排队任务数低水位 */
+    int             watermark_high;         /* 当前是否处于高水位 */
+    queue_watermark_callback watermark_cb;  /* 水位变化回调 */
+    unsigned long   rejects;                /* 队列满被拒绝的任务数 */
+    int             draining;               /* 是否正在排空, 排空期间拒绝新任务, 线程取不到任务后退出 */
+    int             drain_timeout_ms;       /* 排空等待时间 */
+    uint64_t        drain_deadline;         /* 排空截止时间(单调时钟毫秒), 之后剩余任务直接丢弃 */
     int             shutdown;               /* 是否销毁线程池 */
-    pthread_t       *threadid;
+    pthread_mutex_t thread_lock;
+    pthread_cond_t  thread_exit;            /* 线程退出通知, 销毁线程池时等待所有线程退出 */
+    pthread_attr_t  thread_attr;            /* 工作线程属性, 分离状态及栈大小 */
+    int             cur_thread_num;         /* 当前活动线程数目 */
+    int             min_thread_num;         /* 弹性线程池最少线程数目, 与max_thread_num相等时线程数固定 */
     int             max_thread_num;         /* 线程池中允许的活动线程数目 */
-    int             cur_queue_size;         /* 当前等待队列的任务数目 */
+    int             spawn_wait_ms;          /* 任务排队等待超过该时间且无空闲线程时新增线程 */
+    int             idle_timeout_ms;        /* 线程空闲超过该时间后退出 */
+    pthread_t       monitor;                /* 弹性线程池的监视线程, 定期检查积压并扩容 */
+    int             monitor_running;        /* 监视线程是否已创建 */
+    pthread_cond_t  monitor_wakeup;         /* 通知监视线程退出, 与thread_lock配合使用 */
+    unsigned int    thread_seq;             /* 工作线程编号, 用于线程命名 */
+    leda_thread_sched_t sched;              /* 工作线程调度配置 */
+    leda_latency_histogram_t queue_wait[LEDA_POOL_PRIO_BUTT];   /* 各优先级任务排队时间 */
+    leda_latency_histogram_t run_time[LEDA_POOL_PRIO_BUTT];     /* 各优先级任务执行时间 */
+    pthread_mutex_t histogram_lock[LEDA_POOL_PRIO_BUTT];        /* 各优先级直方图锁, 保护queue_wait及run_time */
+    unsigned long   discards[LEDA_POOL_PRIO_BUTT];              /* 各优先级被丢弃的任务数 */
 } CThread_pool;
 
-void leda_pool_init(int max_thread_num);
+int  leda_pool_init(const leda_init_config_t *config);
 int  leda_pool_add_worker(void *(*process)(void *arg), void *arg);
+int  leda_pool_add_keyed_worker(unsigned int key, void *(*process)(void *arg), void *arg);
+int  leda_pool_add_task(const CThread_task_attr *attr, void *(*process)(void *arg), void *arg);
+void leda_pool_batch_init(CThread_batch *batch);
+int  leda_pool_batch_add(CThread_batch *batch, const CThread_task_attr *attr, void *(*process)(void *arg), void *arg);
+int  leda_pool_batch_commit(CThread_batch *batch);
+int  leda_pool_in_worker(void);
+int  leda_pool_can_run_inline(const CThread_batch *batch, unsigned int key);
+void leda_pool_run_inline(int priority, void *(*process)(void *arg), void *arg);
+int  leda_pool_drain(void);
 int  leda_pool_destroy(void);
 
+void *leda_pool_alloc_request(size_t size);
+void leda_pool_free_request(void *request);
+void leda_pool_get_alloc_stats(CThread_alloc_stats *stats);
+void leda_pool_set_thread_sched(const leda_thread_sched_t *sched);
+int  leda_pool_get_stats(leda_pool_stats_t *stats);
+
 #if defined(__cplusplus) /* If this is a C++ compiler, use C linkage */
 }
 #endif
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2014-2019 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * 设备数据json编码的一致性检查和性能基准测试.
+ *
+ * 参照实现为改用leda_json_writer_t之前的编码方式: 先用cJSON树生成{"key":value}, 再解析后
+ * 包装为{"key":{"time":t,"value":value}}. 两者对同一输入的输出须逐字节一致.
+ *
+ * 用法: json_bench eq [用例数]        随机生成上报数据, 比较两种编码输出, 不一致时返回非0
+ *       json_bench bench [迭代次数]   10个标量属性的上报编码耗时和内存分配次数
+ *
+ * 内存分配通过链接选项--wrap=malloc/calloc/realloc计数, cJSON的分配通过hooks计入.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <dbus/dbus.h>
+#include <cJSON.h>
+
+#include "log.h"
+#include "le_error.h"
+#include "leda.h"
+#include "leda_base.h"
+
+#define JSON_BENCH_TIME_MS      1760000000123LL     /* 固定时间戳, 保证两种编码输入一致 */
+#define JSON_BENCH_DATA_MAX     12
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static long g_allocs = 0;
+
+void *__wrap_malloc(size_t size)
+{
+    g_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    g_allocs++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    g_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+/* 参照实现第一步, 与原leda_transform_data_struct_to_string相同 */
+static char *ref_data_to_string(const leda_device_data_t data[], int count)
+{
+    int     i       = 0;
+    char    *output = NULL;
+    cJSON   *object = NULL;
+
+    object = cJSON_CreateObject();
+    if (NULL == object)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ((LEDA_TYPE_TEXT == data[i].type) || (LEDA_TYPE_DATE == data[i].type))
+        {
+            cJSON_AddStringToObject(object, data[i].key, data[i].value);
+        }
+        else if (LEDA_TYPE_FLOAT == data[i].type)
+        {
+            cJSON_AddNumberToObject(object, data[i].key, strtof(data[i].value, NULL));
+        }
+        else if (LEDA_TYPE_DOUBLE == data[i].type)
+        {
+            cJSON_AddNumberToObject(object, data[i].key, strtod(data[i].value, NULL));
+        }
+        else if ((LEDA_TYPE_INT == data[i].type) 
+                 || (LEDA_TYPE_BOOL == data[i].type) 
+                 || (LEDA_TYPE_ENUM == data[i].type))
+        {
+            cJSON_AddNumberToObject(object, data[i].key, atoi(data[i].value));
+        }
+        else if ((LEDA_TYPE_STRUCT == data[i].type) || (LEDA_TYPE_ARRAY == data[i].type))
+        {
+            cJSON_AddItemToObject(object, data[i].key, cJSON_Parse(data[i].value));
+        }
+        else
+        {
+            cJSON_Delete(object);
+            return NULL;
+        }
+    }
+
+    output = cJSON_PrintUnformatted(object);
+    cJSON_Delete(object);
+
+    return output;
+}
+
+/* 参照实现第二步, 与原_leda_add_property_timestamp相同 */
+static char *ref_add_timestamp(const char *output, long long time_ms)
+{
+    cJSON   *object     = NULL;
+    cJSON   *item       = NULL;
+    cJSON   *new_object = NULL;
+    cJSON   *new_item   = NULL;
+    char    *buff       = NULL;
+
+    object = cJSON_Parse(output);
+    if (NULL == object)
+    {
+        return NULL;
+    }
+
+    new_object = cJSON_CreateObject();
+    if (NULL == new_object)
+    {
+        cJSON_Delete(object);
+        return NULL;
+    }
+
+    cJSON_ArrayForEach(item, object)
+    {
+        new_item = cJSON_CreateObject();
+        if (NULL == new_item)
+        {
+            break;
+        }
+
+        cJSON_AddNumberToObject(new_item, "time", (double)time_ms);
+        if (cJSON_False == item->type)
+        {
+            cJSON_AddFalseToObject(new_item, "value");
+        }
+        else if (cJSON_True == item->type)
+        {
+            cJSON_AddTrueToObject(new_item, "value");
+        }
+        else if (cJSON_NULL == item->type)
+        {
+            cJSON_AddNullToObject(new_item, "value");
+        }
+        else if (cJSON_Number == item->type)
+        {
+            cJSON_AddNumberToObject(new_item, "value", item->valuedouble);
+        }
+        else if (cJSON_String == item->type)
+        {
+            cJSON_AddStringToObject(new_item, "value", item->valuestring);
+        }
+        else if ((cJSON_Array == item->type) || (cJSON_Object == item->type))
+        {
+            cJSON_AddItemToObject(new_item, "value", cJSON_Duplicate(item, 1));
+        }
+        else
+        {
+            cJSON_Delete(new_item);
+            continue;
+        }
+        cJSON_AddItemToObject(new_object, item->string, new_item);
+    }
+    cJSON_Delete(object);
+
+    buff = cJSON_PrintUnformatted(new_object);
+    cJSON_Delete(new_object);
+
+    return buff;
+}
+
+static char *ref_encode(const leda_device_data_t data[], int count)
+{
+    char *output = NULL;
+    char *buff   = NULL;
+
+    output = ref_data_to_string(data, count);
+    if (NULL == output)
+    {
+        return NULL;
+    }
+
+    buff = ref_add_timestamp(output, JSON_BENCH_TIME_MS);
+    free(output);
+
+    return buff;
+}
+
+static char *writer_encode(const leda_device_data_t data[], int count)
+{
+    char                stack_buff[LEDA_JSON_STACK_BUFF_SIZE];
+    char                *output = NULL;
+    leda_json_writer_t  writer;
+
+    leda_json_writer_init(&writer, stack_buff, sizeof(stack_buff));
+    if (LE_SUCCESS == leda_json_write_data(&writer, data, count, JSON_BENCH_TIME_MS))
+    {
+        output = strdup(writer.buf);
+    }
+    leda_json_writer_free(&writer);
+
+    return output;
+}
+
+/* 随机生成覆盖转义字符, 浮点数, nan和非法结构体的上报数据 */
+static void gen_data(leda_device_data_t data[], int count, unsigned int *seed)
+{
+    int                 i           = 0;
+    static const char   *texts[]    = {"hello", "a\"b", "back\\slash", "tab\there", "nl\nx", "\x01\x1f ctl", 
+                                       "utf8 \xe4\xb8\xad\xe6\x96\x87", "slash/ok", ""};
+    static const char   *floats[]   = {"1.1", "0.1", "-3.14159", "1e300", "123456789.125", "0", "nan", "3.0000001"};
+    static const char   *structs[]  = {"{\"a\": 1, \"b\" : [1, 2.5, \"x\"]}", "[ ]", "{\"n\":1e-7,\"s\":\"\\u00e9\\/\"}", 
+                                       "not json", "[1,2,{\"k\":null,\"t\":true}]"};
+
+    for (i = 0; i < count; i++)
+    {
+        memset(&data[i], 0, sizeof(leda_device_data_t));
+        data[i].type = rand_r(seed) % (LEDA_TYPE_DOUBLE + 1);
+        snprintf(data[i].key, sizeof(data[i].key), "k%d%s", i, (0 == i % 4) ? "\"q" : "");
+
+        switch (data[i].type)
+        {
+            case LEDA_TYPE_TEXT:
+            case LEDA_TYPE_DATE:
+                strcpy(data[i].value, texts[rand_r(seed) % (sizeof(texts) / sizeof(texts[0]))]);
+                break;
+            case LEDA_TYPE_FLOAT:
+            case LEDA_TYPE_DOUBLE:
+                strcpy(data[i].value, floats[rand_r(seed) % (sizeof(floats) / sizeof(floats[0]))]);
+                break;
+            case LEDA_TYPE_STRUCT:
+            case LEDA_TYPE_ARRAY:
+                strcpy(data[i].value, structs[rand_r(seed) % (sizeof(structs) / sizeof(structs[0]))]);
+                break;
+            default:
+                snprintf(data[i].value, sizeof(data[i].value), "%d", (int)(rand_r(seed) % 200000) - 100000);
+                break;
+        }
+    }
+}
+
+static int check_equal(int cases)
+{
+    int                 i           = 0;
+    int                 count       = 0;
+    int                 mismatch    = 0;
+    unsigned int        seed        = 42;
+    char                *expect     = NULL;
+    char                *actual     = NULL;
+    leda_device_data_t  data[JSON_BENCH_DATA_MAX];
+
+    for (i = 0; i < cases; i++)
+    {
+        count = 1 + rand_r(&seed) % JSON_BENCH_DATA_MAX;
+        gen_data(data, count, &seed);
+
+        expect = ref_encode(data, count);
+        actual = writer_encode(data, count);
+        if ((NULL == expect) || (NULL == actual) || strcmp(expect, actual))
+        {
+            mismatch++;
+            printf("case %d mismatch\n  expect: %s\n  actual: %s\n", i, expect ? expect : "(null)", actual ? actual : "(null)");
+        }
+        free(expect);
+        free(actual);
+    }
+
+    printf("%d cases, %d mismatches\n", cases, mismatch);
+
+    return (0 == mismatch) ? LE_SUCCESS : LE_ERROR_UNKNOWN;
+}
+
+static void run_bench(int iters)
+{
+    int                 i       = 0;
+    long                allocs  = 0;
+    struct timespec     start;
+    struct timespec     end;
+    char                *output = NULL;
+    leda_device_data_t  data[10];
+
+    /* 典型上报: 整数, 浮点, 字符串和布尔属性各若干 */
+    for (i = 0; i < 10; i++)
+    {
+        memset(&data[i], 0, sizeof(leda_device_data_t));
+        snprintf(data[i].key, sizeof(data[i].key), "property_%d", i);
+        switch (i % 4)
+        {
+            case 0:  data[i].type = LEDA_TYPE_INT;   strcpy(data[i].value, "1234");    break;
+            case 1:  data[i].type = LEDA_TYPE_FLOAT; strcpy(data[i].value, "23.5");    break;
+            case 2:  data[i].type = LEDA_TYPE_TEXT;  strcpy(data[i].value, "running"); break;
+            default: data[i].type = LEDA_TYPE_BOOL;  strcpy(data[i].value, "1");       break;
+        }
+    }
+
+    allocs = g_allocs;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < iters; i++)
+    {
+        output = ref_encode(data, 10);
+        free(output);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("cjson tree:  %.0f ns, %.2f allocations per report\n", 
+           ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / iters, 
+           (double)(g_allocs - allocs) / iters);
+
+    allocs = g_allocs;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < iters; i++)
+    {
+        char                stack_buff[LEDA_JSON_STACK_BUFF_SIZE];
+        leda_json_writer_t  writer;
+
+        leda_json_writer_init(&writer, stack_buff, sizeof(stack_buff));
+        leda_json_write_data(&writer, data, 10, JSON_BENCH_TIME_MS);
+        leda_json_writer_free(&writer);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("json writer: %.0f ns, %.2f allocations per report\n", 
+           ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / iters, 
+           (double)(g_allocs - allocs) / iters);
+}
+
+int main(int argc, char** argv)
+{
+    int             num     = 0;
+    cJSON_Hooks     hooks;
+
+    if ((argc < 2) || (strcmp(argv[1], "eq") && strcmp(argv[1], "bench")))
+    {
+        fprintf(stderr, "usage: %s eq [cases] | bench [iterations]\n", argv[0]);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    if (argc > 2)
+    {
+        num = atoi(argv[2]);
+    }
+
+    log_init("json_bench", LOG_STDOUT, LOG_LEVEL_ERR, LOG_MOD_BRIEF);
+
+    /* cJSON位于动态库, 通过hooks计入其内存分配 */
+    hooks.malloc_fn = __wrap_malloc;
+    hooks.free_fn   = free;
+    cJSON_InitHooks(&hooks);
+
+    if (!strcmp(argv[1], "eq"))
+    {
+        return check_equal((num > 0) ? num : 3000);
+    }
+
+    run_bench((num > 0) ? num : 200000);
+
+    return LE_SUCCESS;
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2014-2019 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * 线程池基准测试, 不依赖总线, 直接调用线程池接口.
+ *
+ * 竞争模式: 对比共享队列和工作窃取两种调度模式. 按固定速率成批提交串行任务, 任务按64个设备分片,
+ * 每个任务忙等task_us微秒, 统计任务从提交到开始执行的排队时间分位数和进程CPU时间.
+ *
+ * 吞吐模式: 分别以1/4/16个工作线程, 由单个线程连续提交空任务, 统计入队速率和全部任务执行完的整体速率.
+ *
+ * 用法: pool_bench [工作线程数] [每秒任务数] [每批任务数] [运行秒数] [任务耗时us]
+ *       pool_bench throughput [任务数]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+
+#include "log.h"
+#include "le_error.h"
+#include "leda.h"
+#include "leda_trpool.h"
+
+#define POOL_BENCH_DEVICE_NUMS      64          /* 任务按设备分片的个数 */
+#define POOL_BENCH_TASK_MAX         400000      /* 单轮最多提交的任务数 */
+#define POOL_BENCH_THROUGHPUT_TASKS 200000      /* 吞吐模式默认提交的任务数 */
+
+typedef struct pool_bench_task
+{
+    double  submit;                             /* 提交时间(秒) */
+    double  wait;                               /* 排队时间(秒) */
+} pool_bench_task_t;
+
+static pool_bench_task_t    g_tasks[POOL_BENCH_TASK_MAX];
+static volatile long        g_done      = 0;
+static int                  g_task_us   = 20;
+
+static double now_sec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double cpu_sec(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void *bench_task(void *arg)
+{
+    pool_bench_task_t   *task   = (pool_bench_task_t *)arg;
+    double              start   = now_sec();
+
+    task->wait = start - task->submit;
+    while ((now_sec() - start) < (g_task_us * 1e-6))
+    {
+    }
+    __sync_fetch_and_add(&g_done, 1);
+
+    return NULL;
+}
+
+static void *bench_empty_task(void *arg)
+{
+    (void)arg;
+    __sync_fetch_and_add(&g_done, 1);
+
+    return NULL;
+}
+
+static int compare_wait(const void *a, const void *b)
+{
+    double x = ((const pool_bench_task_t *)a)->wait;
+    double y = ((const pool_bench_task_t *)b)->wait;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+static int run_mode(int pool_mode, int workers, int rate, int burst, double seconds)
+{
+    long                i       = 0;
+    int                 j       = 0;
+    long                count   = 0;
+    double              start   = 0;
+    double              cpu     = 0;
+    double              wall    = 0;
+    leda_init_config_t  config;
+
+    memset(&config, 0, sizeof(config));
+    config.worker_thread_nums = workers;
+    config.pool_mode          = pool_mode;
+    if (LE_SUCCESS != leda_pool_init(&config))
+    {
+        fprintf(stderr, "thread pool init failed\n");
+        return LE_ERROR_UNKNOWN;
+    }
+    usleep(100000);
+
+    count = (long)(rate * seconds);
+    if (count > POOL_BENCH_TASK_MAX)
+    {
+        count = POOL_BENCH_TASK_MAX;
+    }
+    g_done = 0;
+
+    /* 每burst/rate秒提交一批, 模拟分发线程成批收到请求 */
+    cpu   = cpu_sec();
+    start = now_sec();
+    while (i < count)
+    {
+        while (now_sec() < (start + (double)i / rate))
+        {
+            usleep(50);
+        }
+
+        for (j = 0; (j < burst) && (i < count); j++, i++)
+        {
+            g_tasks[i].submit = now_sec();
+            if (LE_SUCCESS != leda_pool_add_keyed_worker((unsigned int)(i % POOL_BENCH_DEVICE_NUMS), bench_task, &g_tasks[i]))
+            {
+                __sync_fetch_and_add(&g_done, 1);
+            }
+        }
+    }
+
+    while (g_done < count)
+    {
+        usleep(100);
+    }
+    wall = now_sec() - start;
+    cpu  = cpu_sec() - cpu;
+    leda_pool_destroy();
+
+    qsort(g_tasks, count, sizeof(pool_bench_task_t), compare_wait);
+    printf("%-8s workers=%d rate=%d burst=%d: wait p50=%.1fus p99=%.1fus max=%.1fus, cpu=%.2fs/%.2fs wall\n", 
+           (LEDA_POOL_MODE_STEALING == pool_mode) ? "stealing" : "shared", 
+           workers, rate, burst, 
+           g_tasks[count / 2].wait * 1e6, 
+           g_tasks[count * 99 / 100].wait * 1e6, 
+           g_tasks[count - 1].wait * 1e6, 
+           cpu, wall);
+
+    return LE_SUCCESS;
+}
+
+static int run_throughput(int workers, long count)
+{
+    long                i       = 0;
+    double              start   = 0;
+    double              enqueue = 0;
+    double              wall    = 0;
+    leda_init_config_t  config;
+
+    memset(&config, 0, sizeof(config));
+    config.worker_thread_nums = workers;
+    if (LE_SUCCESS != leda_pool_init(&config))
+    {
+        fprintf(stderr, "thread pool init failed\n");
+        return LE_ERROR_UNKNOWN;
+    }
+    usleep(100000);
+
+    g_done = 0;
+    start  = now_sec();
+    for (i = 0; i < count; i++)
+    {
+        if (LE_SUCCESS != leda_pool_add_worker(bench_empty_task, NULL))
+        {
+            __sync_fetch_and_add(&g_done, 1);
+        }
+    }
+    enqueue = now_sec() - start;
+
+    while (g_done < count)
+    {
+        sched_yield();
+    }
+    wall = now_sec() - start;
+    leda_pool_destroy();
+
+    printf("throughput workers=%-2d tasks=%ld: enqueue %.0f ops/s, end to end %.0f ops/s\n", 
+           workers, count, count / enqueue, count / wall);
+
+    return LE_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    int     workers = 4;
+    int     rate    = 10000;
+    int     burst   = 100;
+    double  seconds = 3;
+
+    if ((argc > 1) && !strcmp(argv[1], "throughput"))
+    {
+        long count = (argc > 2) ? atol(argv[2]) : POOL_BENCH_THROUGHPUT_TASKS;
+        int  nums[] = {1, 4, 16};
+        int  i      = 0;
+
+        if (count <= 0)
+        {
+            fprintf(stderr, "usage: %s throughput [tasks]\n", argv[0]);
+            return LE_ERROR_INVAILD_PARAM;
+        }
+
+        log_init("pool_bench", LOG_STDOUT, LOG_LEVEL_ERR, LOG_MOD_BRIEF);
+        for (i = 0; i < (int)(sizeof(nums) / sizeof(nums[0])); i++)
+        {
+            if (LE_SUCCESS != run_throughput(nums[i], count))
+            {
+                return LE_ERROR_UNKNOWN;
+            }
+        }
+
+        return LE_SUCCESS;
+    }
+
+    if (argc > 1)
+    {
+        workers = atoi(argv[1]);
+    }
+
+    if (argc > 2)
+    {
+        rate = atoi(argv[2]);
+    }
+
+    if (argc > 3)
+    {
+        burst = atoi(argv[3]);
+    }
+
+    if (argc > 4)
+    {
+        seconds = atof(argv[4]);
+    }
+
+    if (argc > 5)
+    {
+        g_task_us = atoi(argv[5]);
+    }
+
+    if ((workers <= 0) || (rate <= 0) || (burst <= 0) || (seconds <= 0))
+    {
+        fprintf(stderr, "usage: %s [workers] [tasks_per_sec] [burst] [seconds] [task_us]\n", argv[0]);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    log_init("pool_bench", LOG_STDOUT, LOG_LEVEL_ERR, LOG_MOD_BRIEF);
+
+    if ((LE_SUCCESS != run_mode(LEDA_POOL_MODE_SHARED, workers, rate, burst, seconds)) 
+        || (LE_SUCCESS != run_mode(LEDA_POOL_MODE_STEALING, workers, rate, burst, seconds)))
+    {
+        return LE_ERROR_UNKNOWN;
+    }
+
+    return LE_SUCCESS;
+}
@@ -0,0 +1,30 @@
+CFLAGS  = -g -Wall -O2
+
+INCLUDE_PATH = -I$(PWD)/build/include
+INCLUDE      = -I./ -I../../src $(INCLUDE_PATH)/ $(INCLUDE_PATH)/cjson $(INCLUDE_PATH)/dbus-1.0
+
+LIB_PATH = -L$(PWD)/build/lib
+LIB 	 =  -lleda_sdk_c  \
+			-lcjson       \
+			-lpthread     \
+			-ldbus-1
+
+OBJS     = ./pool_bench.o
+
+TOOL_NAME   = pool_bench
+TARGET      = pool_bench
+
+all : $(TARGET)
+
+$(TARGET): $(OBJS)
+	$(CC) $^ -o $@ $(CFLAGS) $(INCLUDE) $(LIB_PATH) $(LIB)
+
+$(OBJS):%o:%c
+	$(CC) -c $< -o $@ $(CFLAGS) $(INCLUDE)
+
+install :
+	mkdir -p $(PWD)/build/bin/tools/$(TOOL_NAME)/
+	cp $(TARGET) $(PWD)/build/bin/tools/$(TOOL_NAME)/
+
+clean:
+	-$(RM) $(TARGET) $(OBJS)
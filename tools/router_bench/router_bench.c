@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2014-2019 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * 消息路由基准测试, 不依赖总线, 直接构造设备方法调用消息.
+ *
+ * 分别注册10/100/1000个设备, 按设备轮转驱动合成消息经leda_methodcb_route和
+ * leda_get_methodcb_by_cloud_id路由到设备, 统计每秒消息数和每条消息的内存分配次数.
+ * 参照实现为改用哈希路由之前的方式: 从路径拷贝cloud_id, 再遍历设备链表逐个比较.
+ *
+ * 用法: router_bench [消息数]
+ *
+ * 内存分配通过链接选项--wrap=malloc/calloc/realloc计数.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <dbus/dbus.h>
+#include <cJSON.h>
+
+#include "log.h"
+#include "le_error.h"
+#include "leda.h"
+#include "linux-list.h"
+#include "leda_base.h"
+#include "leda_trpool.h"
+#include "leda_mainloop.h"
+#include "leda_methodcb.h"
+
+#define ROUTER_BENCH_MESSAGES       100000      /* 默认消息数 */
+#define ROUTER_BENCH_STRIDE         7919        /* 消息在设备间轮转的步长, 避免顺序访问 */
+
+typedef struct router_bench_device
+{
+    struct list_head    list_node;
+    char                *cloud_id;
+} router_bench_device_t;
+
+extern pthread_mutex_t g_methodcb_list_lock;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static long             g_allocs = 0;
+static LIST_HEAD(g_ref_head);
+static pthread_mutex_t  g_ref_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void *__wrap_malloc(size_t size)
+{
+    g_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    g_allocs++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    g_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+static double now_sec(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* 参照实现: 拷贝cloud_id后遍历链表查找 */
+static router_bench_device_t *ref_route(DBusMessage *message)
+{
+    const char              *path       = dbus_message_get_path(message);
+    char                    *cloud_id   = NULL;
+    router_bench_device_t   *pos        = NULL;
+    router_bench_device_t   *found      = NULL;
+
+    if (LE_SUCCESS != leda_path_is_vaild(path))
+    {
+        return NULL;
+    }
+
+    cloud_id = (char *)malloc(strlen(path) - strlen(LEDA_PATH_NAME) + 1);
+    if (NULL == cloud_id)
+    {
+        return NULL;
+    }
+    strcpy(cloud_id, path + strlen(LEDA_PATH_NAME));
+
+    pthread_mutex_lock(&g_ref_lock);
+    list_for_each_entry(pos, &g_ref_head, list_node)
+    {
+        if (strcmp(pos->cloud_id, cloud_id) == 0)
+        {
+            found = pos;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_ref_lock);
+    free(cloud_id);
+
+    return found;
+}
+
+static int run_devices(int devices, long count)
+{
+    int                     i           = 0;
+    long                    k           = 0;
+    long                    hits[2]     = {0, 0};
+    long                    allocs[2]   = {0, 0};
+    double                  cost[2]     = {0, 0};
+    double                  start       = 0;
+    char                    name[128];
+    DBusMessage             **messages  = NULL;
+    router_bench_device_t   *devs       = NULL;
+    leda_device_callback_t  device_cb;
+
+    messages = (DBusMessage **)calloc(devices, sizeof(DBusMessage *));
+    devs     = (router_bench_device_t *)calloc(devices, sizeof(router_bench_device_t));
+    if ((NULL == messages) || (NULL == devs))
+    {
+        free(messages);
+        free(devs);
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    memset(&device_cb, 0, sizeof(device_cb));
+    for (i = 0; i < devices; i++)
+    {
+        snprintf(name, sizeof(name), "a1b2c3d4e5f6dev%05d", i);
+        (void)leda_insert_methodcb(name, i, "a1b2c3d4e5f6", 0, name, &device_cb, 1, NULL);
+
+        devs[i].cloud_id = strdup(name);
+        list_add_tail(&devs[i].list_node, &g_ref_head);
+
+        snprintf(name, sizeof(name), "%sa1b2c3d4e5f6dev%05d", LEDA_PATH_NAME, i);
+        messages[i] = dbus_message_new_method_call(LEDA_DRIVER_WKN, name, LEDA_DEVICE_WKN, "callServices");
+    }
+
+    g_allocs = 0;
+    start    = now_sec();
+    for (k = 0; k < count; k++)
+    {
+        if (NULL != ref_route(messages[(k * ROUTER_BENCH_STRIDE) % devices]))
+        {
+            hits[0]++;
+        }
+    }
+    cost[0]   = now_sec() - start;
+    allocs[0] = g_allocs;
+
+    g_allocs = 0;
+    start    = now_sec();
+    for (k = 0; k < count; k++)
+    {
+        if (NULL != leda_get_methodcb_by_cloud_id(leda_methodcb_route(messages[(k * ROUTER_BENCH_STRIDE) % devices])))
+        {
+            hits[1]++;
+        }
+    }
+    cost[1]   = now_sec() - start;
+    allocs[1] = g_allocs;
+
+    printf("devices=%-4d messages=%ld: reference %.0f msg/s (%.0fns, %.1f allocs/msg, hits=%ld), "
+           "router %.0f msg/s (%.0fns, %.1f allocs/msg, hits=%ld)\n", 
+           devices, count, 
+           count / cost[0], cost[0] * 1e9 / count, (double)allocs[0] / count, hits[0], 
+           count / cost[1], cost[1] * 1e9 / count, (double)allocs[1] / count, hits[1]);
+
+    for (i = 0; i < devices; i++)
+    {
+        leda_remove_methodcb(i);
+        list_del(&devs[i].list_node);
+        free(devs[i].cloud_id);
+        dbus_message_unref(messages[i]);
+    }
+    free(messages);
+    free(devs);
+
+    return ((hits[0] == count) && (hits[1] == count)) ? LE_SUCCESS : LE_ERROR_UNKNOWN;
+}
+
+int main(int argc, char** argv)
+{
+    long    count       = ROUTER_BENCH_MESSAGES;
+    int     devices[]   = {10, 100, 1000};
+    int     i           = 0;
+
+    if (argc > 1)
+    {
+        count = atol(argv[1]);
+    }
+
+    if (count <= 0)
+    {
+        fprintf(stderr, "usage: %s [messages]\n", argv[0]);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    log_init("router_bench", LOG_STDOUT, LOG_LEVEL_ERR, LOG_MOD_BRIEF);
+    pthread_mutex_init(&g_methodcb_list_lock, NULL);
+
+    for (i = 0; i < (int)(sizeof(devices) / sizeof(devices[0])); i++)
+    {
+        if (LE_SUCCESS != run_devices(devices[i], count))
+        {
+            fprintf(stderr, "some messages were not routed\n");
+            return LE_ERROR_UNKNOWN;
+        }
+    }
+
+    return LE_SUCCESS;
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2014-2019 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * 基准测试用DMP替身, 占用dimu/configmanager/subscribe三个WKN, 对所有方法调用返回成功.
+ *
+ * 环境变量DMP_LATENCY_MS指定应答延迟, 延迟期间继续处理其他请求, 模拟并发处理请求的DMP.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <dbus/dbus.h>
+#include <cJSON.h>
+
+#include "leda.h"
+#include "leda_base.h"
+
+#define DMP_STUB_PENDING_MAX    65536   /* 延迟应答队列长度 */
+#define DMP_STUB_RESULT_SIZE    512
+
+typedef struct dmp_stub_pending
+{
+    long long   due_ms;                 /* 应答发送时间(单调时钟毫秒) */
+    DBusMessage *reply;
+} dmp_stub_pending_t;
+
+static dmp_stub_pending_t   g_pending[DMP_STUB_PENDING_MAX];
+static unsigned int         g_pending_head  = 0;
+static unsigned int         g_pending_tail  = 0;
+static int                  g_latency_ms    = 0;
+
+static long long dmp_stub_now_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/* 发送应答, 配置了延迟时先入队, 队列满时立即发送 */
+static void dmp_stub_send(DBusConnection *connection, DBusMessage *reply)
+{
+    dmp_stub_pending_t *pending = NULL;
+
+    if ((0 == g_latency_ms) || ((g_pending_tail - g_pending_head) >= DMP_STUB_PENDING_MAX))
+    {
+        dbus_connection_send(connection, reply, NULL);
+        dbus_message_unref(reply);
+        return;
+    }
+
+    pending = &g_pending[g_pending_tail % DMP_STUB_PENDING_MAX];
+    pending->due_ms = dmp_stub_now_ms() + g_latency_ms;
+    pending->reply  = reply;
+    g_pending_tail++;
+}
+
+/* 发出已到期的应答, 返回距下一个应答到期的毫秒数, 无待发应答返回-1 */
+static int dmp_stub_flush(DBusConnection *connection)
+{
+    long long           now     = dmp_stub_now_ms();
+    dmp_stub_pending_t  *pending = NULL;
+
+    while (g_pending_head != g_pending_tail)
+    {
+        pending = &g_pending[g_pending_head % DMP_STUB_PENDING_MAX];
+        if (pending->due_ms > now)
+        {
+            return (int)(pending->due_ms - now);
+        }
+
+        dbus_connection_send(connection, pending->reply, NULL);
+        dbus_message_unref(pending->reply);
+        g_pending_head++;
+    }
+
+    return -1;
+}
+
+/* dimu接口应答为json字符串, connect返回由productKey和设备名拼成的cloud_id */
+static void dmp_stub_dimu(DBusConnection *connection, DBusMessage *message)
+{
+    char        result[DMP_STUB_RESULT_SIZE];
+    const char  *params     = result;
+    char        *info       = NULL;
+    cJSON       *object     = NULL;
+    cJSON       *product_key = NULL;
+    cJSON       *name       = NULL;
+    DBusMessage *reply      = NULL;
+
+    snprintf(result, sizeof(result), "{\"code\":0,\"message\":\"ok\",\"params\":{}}");
+    if ((!strcmp(dbus_message_get_member(message), DMP_METHOD_CONNECT)) 
+        && (dbus_message_get_args(message, NULL, DBUS_TYPE_STRING, &info, DBUS_TYPE_INVALID)) 
+        && (NULL != (object = cJSON_Parse(info))))
+    {
+        product_key = cJSON_GetObjectItem(object, "productKey");
+        name        = cJSON_GetObjectItem(object, "deviceName");
+        if (NULL == name)
+        {
+            name = cJSON_GetObjectItem(object, "deviceLocalId");
+        }
+
+        if ((NULL != product_key) && (NULL != name))
+        {
+            snprintf(result, sizeof(result), "{\"code\":0,\"message\":\"ok\",\"params\":{\"deviceCloudId\":\"%s_%s\"}}", 
+                     product_key->valuestring, name->valuestring);
+        }
+        cJSON_Delete(object);
+    }
+
+    reply = dbus_message_new_method_return(message);
+    if (NULL == reply)
+    {
+        return;
+    }
+    dbus_message_append_args(reply, DBUS_TYPE_STRING, &params, DBUS_TYPE_INVALID);
+    dmp_stub_send(connection, reply);
+}
+
+/* configmanager接口应答为错误码和配置内容, 配置一律不存在 */
+static void dmp_stub_configmanager(DBusConnection *connection, DBusMessage *message)
+{
+    int         code    = 0;
+    const char  *value  = "";
+    DBusMessage *reply  = NULL;
+
+    reply = dbus_message_new_method_return(message);
+    if (NULL == reply)
+    {
+        return;
+    }
+
+    if (!strcmp(dbus_message_get_member(message), DMP_CONFIGMANAGER_METHOD_GET))
+    {
+        code = 1;
+        dbus_message_append_args(reply, DBUS_TYPE_INT32, &code, DBUS_TYPE_STRING, &value, DBUS_TYPE_INVALID);
+    }
+    else
+    {
+        dbus_message_append_args(reply, DBUS_TYPE_INT32, &code, DBUS_TYPE_INVALID);
+    }
+    dmp_stub_send(connection, reply);
+}
+
+static int dmp_stub_request_name(DBusConnection *connection, const char *name)
+{
+    DBusError error;
+
+    dbus_error_init(&error);
+    dbus_bus_request_name(connection, name, DBUS_NAME_FLAG_REPLACE_EXISTING, &error);
+    if (dbus_error_is_set(&error))
+    {
+        fprintf(stderr, "request name %s failed: %s\n", name, error.message);
+        dbus_error_free(&error);
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    DBusError       error;
+    DBusConnection  *connection = NULL;
+    DBusMessage     *message    = NULL;
+    const char      *address    = bus_address;
+    const char      *destination = NULL;
+    int             timeout_ms  = -1;
+
+    if (argc > 1)
+    {
+        address = argv[1];
+    }
+
+    if (NULL != getenv("DMP_LATENCY_MS"))
+    {
+        g_latency_ms = atoi(getenv("DMP_LATENCY_MS"));
+    }
+
+    dbus_error_init(&error);
+    connection = dbus_connection_open(address, &error);
+    if ((NULL == connection) || (TRUE != dbus_bus_register(connection, &error)))
+    {
+        fprintf(stderr, "connect %s failed: %s\n", address, error.message);
+        dbus_error_free(&error);
+        return 1;
+    }
+
+    if ((0 != dmp_stub_request_name(connection, DMP_DIMU_WELL_KNOWN_NAME)) 
+        || (0 != dmp_stub_request_name(connection, DMP_CONFIGMANAGER_WELL_KNOW_NAME)) 
+        || (0 != dmp_stub_request_name(connection, DMP_SUB_WELL_KNOWN_NAME)))
+    {
+        return 1;
+    }
+    fprintf(stderr, "dmp stub ready, latency: %dms\n", g_latency_ms);
+
+    while (dbus_connection_read_write(connection, timeout_ms))
+    {
+        while (NULL != (message = dbus_connection_pop_message(connection)))
+        {
+            if (DBUS_MESSAGE_TYPE_METHOD_CALL == dbus_message_get_type(message))
+            {
+                destination = dbus_message_get_destination(message);
+                if ((NULL != destination) && (!strcmp(destination, DMP_CONFIGMANAGER_WELL_KNOW_NAME)))
+                {
+                    dmp_stub_configmanager(connection, message);
+                }
+                else
+                {
+                    dmp_stub_dimu(connection, message);
+                }
+            }
+            dbus_message_unref(message);
+        }
+
+        timeout_ms = dmp_stub_flush(connection);
+    }
+
+    return 0;
+}
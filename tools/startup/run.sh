@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# 启动私有dbus-daemon和dmp_stub后运行startup_bench, 结束后清理.
+#
+# 用法: run.sh [设备个数] [批量注册窗口], 环境变量DMP_LATENCY_MS指定DMP应答延迟, 默认5ms.
+# dbus-daemon默认从PATH查找, 可通过环境变量DBUS_DAEMON指定.
+
+cd $(dirname $0)
+
+DBUS_DAEMON=${DBUS_DAEMON:-dbus-daemon}
+DMP_LATENCY_MS=${DMP_LATENCY_MS:-5}
+FUNCTION_ID=${FUNCTION_ID:-startup_bench}
+FUNCTION_NAME=${FUNCTION_NAME:-startup_bench}
+export DMP_LATENCY_MS FUNCTION_ID FUNCTION_NAME
+
+mkdir -p /tmp/var/run/mbusd
+rm -f /tmp/var/run/mbusd/mbusd_socket
+
+$DBUS_DAEMON --config-file=./bus.conf --nofork --nopidfile &
+BUS_PID=$!
+sleep 0.5
+
+./dmp_stub &
+DMP_PID=$!
+sleep 0.5
+
+./startup_bench "$@"
+RET=$?
+
+kill $DMP_PID $BUS_PID
+exit $RET
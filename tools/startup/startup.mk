@@ -0,0 +1,36 @@
+CONFIG_MBUS_UNIX_PATH = /tmp/var/run/mbusd/mbusd_socket
+
+CFLAGS  = -g -Wall -O2
+CFLAGS  += -Dbus_address=\"unix:path=$(CONFIG_MBUS_UNIX_PATH)\"
+
+INCLUDE_PATH = -I$(PWD)/build/include
+INCLUDE      = -I./ -I../../src $(INCLUDE_PATH)/ $(INCLUDE_PATH)/cjson $(INCLUDE_PATH)/dbus-1.0
+
+LIB_PATH = -L$(PWD)/build/lib
+LIB 	 =  -lleda_sdk_c  \
+			-lcjson       \
+			-lpthread     \
+			-ldbus-1
+
+OBJS     = ./startup_bench.o ./dmp_stub.o
+
+TOOL_NAME   = startup
+TARGET      = startup_bench dmp_stub
+
+all : $(TARGET)
+
+startup_bench: ./startup_bench.o
+	$(CC) $^ -o $@ $(CFLAGS) $(INCLUDE) $(LIB_PATH) $(LIB)
+
+dmp_stub: ./dmp_stub.o
+	$(CC) $^ -o $@ $(CFLAGS) $(INCLUDE) $(LIB_PATH) -lcjson -ldbus-1
+
+$(OBJS):%o:%c
+	$(CC) -c $< -o $@ $(CFLAGS) $(INCLUDE)
+
+install :
+	mkdir -p $(PWD)/build/bin/tools/$(TOOL_NAME)/
+	cp $(TARGET) bus.conf run.sh $(PWD)/build/bin/tools/$(TOOL_NAME)/
+
+clean:
+	-$(RM) $(TARGET) $(OBJS)
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2014-2019 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * 驱动启动基准测试, 对比逐个同步注册和批量注册上线设备的耗时.
+ *
+ * 用法: startup_bench [设备个数] [批量注册窗口], 需先启动总线和dmp_stub, 见run.sh.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "log.h"
+#include "le_error.h"
+#include "leda.h"
+
+#define TAG_STARTUP_BENCH       "startup_bench"
+#define DEVICE_NAME_SIZE        32
+
+static int get_properties_callback_cb(device_handle_t dev_handle, 
+                               leda_device_data_t properties[], 
+                               int properties_count, 
+                               void *usr_data)
+{
+    return LE_SUCCESS;
+}
+
+static int set_properties_callback_cb(device_handle_t dev_handle, 
+                               const leda_device_data_t properties[], 
+                               int properties_count, 
+                               void *usr_data)
+{
+    return LE_SUCCESS;
+}
+
+static int call_service_callback_cb(device_handle_t dev_handle, 
+                               const char *service_name, 
+                               const leda_device_data_t data[], 
+                               int data_count, 
+                               leda_device_data_t output_data[], 
+                               void *usr_data)
+{
+    return LE_SUCCESS;
+}
+
+static long long now_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int main(int argc, char** argv)
+{
+    int                             i           = 0;
+    int                             count       = 1000;
+    int                             window      = LEDA_REGISTER_WINDOW_DEFAULT;
+    int                             success     = 0;
+    long long                       start       = 0;
+    long long                       sync_us     = 0;
+    long long                       batch_us    = 0;
+    char                            (*names)[DEVICE_NAME_SIZE] = NULL;
+    device_handle_t                 *handles    = NULL;
+    leda_device_register_info_t     *devices    = NULL;
+    leda_device_callback_t          device_cb;
+
+    if (argc > 1)
+    {
+        count = atoi(argv[1]);
+    }
+
+    if (argc > 2)
+    {
+        window = atoi(argv[2]);
+    }
+
+    if (count <= 0)
+    {
+        fprintf(stderr, "usage: %s [device_count] [window]\n", argv[0]);
+        return LE_ERROR_INVAILD_PARAM;
+    }
+
+    log_init(TAG_STARTUP_BENCH, LOG_STDOUT, LOG_LEVEL_WARN, LOG_MOD_BRIEF);
+
+    names   = calloc(count * 2, DEVICE_NAME_SIZE);
+    handles = calloc(count, sizeof(device_handle_t));
+    devices = calloc(count, sizeof(leda_device_register_info_t));
+    if ((NULL == names) || (NULL == handles) || (NULL == devices))
+    {
+        log_e(TAG_STARTUP_BENCH, "no memory can allocate\n");
+        return LE_ERROR_ALLOCATING_MEM;
+    }
+
+    if (LE_SUCCESS != leda_init(4))
+    {
+        log_e(TAG_STARTUP_BENCH, "leda_init failed\n");
+        return LE_ERROR_UNKNOWN;
+    }
+
+    device_cb.get_properties_cb            = get_properties_callback_cb;
+    device_cb.set_properties_cb            = set_properties_callback_cb;
+    device_cb.call_service_cb              = call_service_callback_cb;
+    device_cb.service_output_max_count     = 1;
+
+    /* 两轮使用不同的设备名, 避免第二轮命中已上线设备 */
+    start = now_us();
+    for (i = 0; i < count; i++)
+    {
+        snprintf(names[i], DEVICE_NAME_SIZE, "sync%d", i);
+        if (INVALID_DEVICE_HANDLE != leda_register_and_online_by_device_name("bench", names[i], &device_cb, NULL))
+        {
+            success++;
+        }
+    }
+    sync_us = now_us() - start;
+    printf("sync:  %d/%d devices online in %lld ms\n", success, count, sync_us / 1000);
+
+    for (i = 0; i < count; i++)
+    {
+        snprintf(names[count + i], DEVICE_NAME_SIZE, "batch%d", i);
+        devices[i].product_key      = "bench";
+        devices[i].device_name      = names[count + i];
+        devices[i].is_local_name    = 0;
+        devices[i].device_cb        = &device_cb;
+        devices[i].usr_data         = NULL;
+    }
+
+    start = now_us();
+    success = leda_register_and_online_batch(devices, count, handles, window);
+    batch_us = now_us() - start;
+    printf("batch: %d/%d devices online in %lld ms, window: %d\n", success, count, batch_us / 1000, window);
+
+    leda_exit();
+
+    free(devices);
+    free(handles);
+    free(names);
+
+    return LE_SUCCESS;
+}
@@ -0,0 +1,18 @@
+all :
+	mkdir -p $(PWD)/build/bin/tools/
+	$(MAKE) -C startup -f startup.mk
+	$(MAKE) -C pool_bench -f pool_bench.mk
+	$(MAKE) -C json_bench -f json_bench.mk
+	$(MAKE) -C router_bench -f router_bench.mk
+
+install:
+	$(MAKE) -C startup -f startup.mk install
+	$(MAKE) -C pool_bench -f pool_bench.mk install
+	$(MAKE) -C json_bench -f json_bench.mk install
+	$(MAKE) -C router_bench -f router_bench.mk install
+
+clean:
+	$(MAKE) -C startup -f startup.mk clean
+	$(MAKE) -C pool_bench -f pool_bench.mk clean
+	$(MAKE) -C json_bench -f json_bench.mk clean
+	$(MAKE) -C router_bench -f router_bench.mk clean